@@ -0,0 +1,225 @@
+/**
+ * @file aesd-circular-arena.c
+ * @brief Circular buffer of entries stored back to back in one wrap-around byte arena
+ *
+ * See aesd-circular-arena.h.  Any necessary locking must be performed by the caller.
+ */
+
+#ifdef __KERNEL__
+    #include <linux/string.h>
+    #include <linux/types.h>
+#else
+    #include <string.h>
+    #include <stddef.h>
+#endif
+
+#include "aesd-circular-arena.h"
+
+static bool is_power_of_two(size_t value){
+    return (value != 0) && ((value & (value - 1)) == 0);
+}
+
+/**
+* @return the number of committed entries stored in @param arena
+*/
+size_t aesd_circular_arena_entry_count(struct aesd_circular_arena *arena){
+    if(arena->full){
+        return (size_t)arena->mask + 1;
+    }
+    return (arena->in_offs - arena->out_offs) & arena->mask;
+}
+
+/**
+* @return the total number of committed bytes stored in @param arena
+*/
+size_t aesd_circular_arena_calculate_size(struct aesd_circular_arena *arena){
+    return arena->head - arena->tail;
+}
+
+/**
+* Drops the oldest entry of @param arena, its bytes become free space.
+*/
+static void aesd_circular_arena_remove_oldest(struct aesd_circular_arena *arena){
+    arena->out_offs = (arena->out_offs + 1) & arena->mask;
+    arena->full = false;
+    arena->tail = (aesd_circular_arena_entry_count(arena) > 0) ? arena->entry[arena->out_offs].start : arena->head;
+}
+
+/**
+* Initializes @param arena to an empty struct using caller storage, which must stay valid while the arena is used.
+* @param data byte arena of @param data_size bytes, a power of two
+* @param entries descriptor slots, @param nr_entries of them, a power of two
+* @return true on success, false if either size is not a power of two
+*/
+bool aesd_circular_arena_init(struct aesd_circular_arena *arena, char *data, size_t data_size,
+            struct aesd_arena_entry *entries, uint32_t nr_entries){
+    if( (data == NULL) || (entries == NULL) || !is_power_of_two(data_size) || !is_power_of_two(nr_entries) ){
+        return false;
+    }
+
+    memset(arena,0,sizeof(struct aesd_circular_arena));
+    arena->data = data;
+    arena->data_mask = data_size - 1;
+    arena->entry = entries;
+    arena->mask = nr_entries - 1;
+    return true;
+}
+
+/**
+* Makes room for @param len more bytes of the pending entry, evicting the oldest entries as needed,
+* and describes where they go.  Copy the bytes into the spans then call aesd_circular_arena_produce().
+* @param span set to the writable memory, in order
+* @return the number of spans used, 0 if @param len is 0 or the pending entry would not fit in the arena
+*/
+size_t aesd_circular_arena_reserve(struct aesd_circular_arena *arena, size_t len,
+            struct aesd_arena_span span[2]){
+    size_t index, first;
+
+    if( (len == 0) || (len > arena->data_mask + 1 - (arena->write - arena->head)) ){
+        return 0;
+    }
+    while((arena->write - arena->tail) + len > arena->data_mask + 1){
+        aesd_circular_arena_remove_oldest(arena);
+    }
+
+    index = arena->write & arena->data_mask;
+    first = arena->data_mask + 1 - index;
+    span[0].ptr = arena->data + index;
+    if(len <= first){
+        span[0].len = len;
+        return 1;
+    }
+    span[0].len = first;
+    span[1].ptr = arena->data;
+    span[1].len = len - first;
+    return 2;
+}
+
+/**
+* Adds @param len bytes, written to the spans returned by aesd_circular_arena_reserve(), to the pending entry
+*/
+void aesd_circular_arena_produce(struct aesd_circular_arena *arena, size_t len){
+    arena->write += len;
+}
+
+/**
+* Copies @param len bytes of @param buf to the end of the pending entry.
+* @return false if the pending entry would no longer fit in the arena, nothing is appended then
+*/
+bool aesd_circular_arena_append(struct aesd_circular_arena *arena, const char *buf, size_t len){
+    struct aesd_arena_span span[2];
+    size_t i, nr_spans;
+
+    if(len == 0){
+        return true;
+    }
+    nr_spans = aesd_circular_arena_reserve(arena, len, span);
+    if(nr_spans == 0){
+        return false;
+    }
+    for(i = 0; i < nr_spans; i++){
+        memcpy(span[i].ptr, buf, span[i].len);
+        buf += span[i].len;
+    }
+    aesd_circular_arena_produce(arena, len);
+    return true;
+}
+
+/**
+* Turns the pending bytes into a new entry, evicting the oldest entry if all slots are used
+*/
+void aesd_circular_arena_commit(struct aesd_circular_arena *arena){
+    struct aesd_arena_entry *entry;
+
+    if(arena->full){
+        aesd_circular_arena_remove_oldest(arena);
+    }
+
+    entry = &arena->entry[arena->in_offs];
+    entry->start = arena->head;
+    entry->size = arena->write - arena->head;
+    if(aesd_circular_arena_entry_count(arena) == 0){
+        arena->tail = arena->head;
+    }
+    arena->head = arena->write;
+
+    arena->in_offs = (arena->in_offs + 1) & arena->mask;
+    if(arena->in_offs == arena->out_offs){
+        arena->full = true;
+    }
+}
+
+/**
+* Drops the pending bytes not committed yet
+*/
+void aesd_circular_arena_discard(struct aesd_circular_arena *arena){
+    arena->write = arena->head;
+}
+
+/**
+* Translates a zero referenced entry index (oldest entry first) and a byte offset within it into
+* the matching char_offset of the stored stream.
+* @return true and sets @param fpos_rtn when entry_index and entry_offset are within the arena, false otherwise
+*/
+bool aesd_circular_arena_fpos_for_entry(struct aesd_circular_arena *arena, size_t entry_index,
+            size_t entry_offset, size_t *fpos_rtn){
+    struct aesd_arena_entry *entry;
+
+    if(entry_index >= aesd_circular_arena_entry_count(arena)){
+        return false;
+    }
+
+    entry = &arena->entry[(arena->out_offs + entry_index) & arena->mask];
+    if(entry_offset >= entry->size){
+        return false;
+    }
+
+    *fpos_rtn = (entry->start - arena->tail) + entry_offset;
+    return true;
+}
+
+/**
+* Describes the committed bytes from @param char_offset on, up to @param len of them, without copying.
+* @param span set to the memory holding the bytes, in order
+* @return the number of spans used, 0 when char_offset is at or past the end of the stored bytes
+*/
+size_t aesd_circular_arena_spans(struct aesd_circular_arena *arena, size_t char_offset, size_t len,
+            struct aesd_arena_span span[2]){
+    size_t size = aesd_circular_arena_calculate_size(arena);
+    size_t index, first;
+
+    if( (char_offset >= size) || (len == 0) ){
+        return 0;
+    }
+    if(len > size - char_offset){
+        len = size - char_offset;
+    }
+
+    index = (arena->tail + char_offset) & arena->data_mask;
+    first = arena->data_mask + 1 - index;
+    span[0].ptr = arena->data + index;
+    if(len <= first){
+        span[0].len = len;
+        return 1;
+    }
+    span[0].len = first;
+    span[1].ptr = arena->data;
+    span[1].len = len - first;
+    return 2;
+}
+
+/**
+* Copies up to @param len committed bytes starting at @param char_offset into @param buf, across entries.
+* @return the number of bytes copied, 0 at the end of the stored bytes
+*/
+size_t aesd_circular_arena_read(struct aesd_circular_arena *arena, size_t char_offset, char *buf, size_t len){
+    struct aesd_arena_span span[2];
+    size_t i, nr_spans, copied = 0;
+
+    nr_spans = aesd_circular_arena_spans(arena, char_offset, len, span);
+    for(i = 0; i < nr_spans; i++){
+        memcpy(buf + copied, span[i].ptr, span[i].len);
+        copied += span[i].len;
+    }
+    return copied;
+}
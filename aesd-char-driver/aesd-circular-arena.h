@@ -0,0 +1,91 @@
+/*
+ * aesd-circular-arena.h
+ *
+ *  @brief Circular buffer variant keeping entry payloads in one byte arena
+ *
+ *  Entries of an aesd_circular_buffer point at separately allocated memory.
+ *  Here the payloads live back to back in a wrap-around byte arena owned by
+ *  the caller, entries are only (start, size) descriptors into it.  The
+ *  stored bytes form one stream, so any read from a file position is at most
+ *  two contiguous spans (two memcpys), and adding an entry needs no allocation.
+ *  The oldest entries are evicted when either the arena bytes or the entry
+ *  slots run out.
+ */
+
+#ifndef AESD_CIRCULAR_ARENA_H
+#define AESD_CIRCULAR_ARENA_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stddef.h> // size_t
+#include <stdint.h> // uintx_t
+#include <stdbool.h>
+#endif
+
+struct aesd_arena_entry
+{
+    /* Stream position of the first byte, wraps like the arena positions */
+    size_t start;
+    /* Number of bytes of the entry */
+    size_t size;
+};
+
+/* Contiguous piece of arena memory, a read or write covers at most two */
+struct aesd_arena_span
+{
+    char *ptr;
+    size_t len;
+};
+
+struct aesd_circular_arena
+{
+    /* Payload bytes, a power of two; byte at stream position pos is data[pos & data_mask] */
+    char *data;
+    size_t data_mask;
+    /* Entry descriptor slots, a power of two */
+    struct aesd_arena_entry *entry;
+    uint32_t mask;
+    /* The current location in the entry structure where the next entry should be stored. */
+    uint32_t in_offs;
+    /* The first location in the entry structure to read from */
+    uint32_t out_offs;
+    /* Set to true when the entry structure is full */
+    bool full;
+    /*
+     * Stream positions, free running and wrapping: tail is the first byte of the
+     * oldest entry, head the end of the newest entry and write the end of bytes
+     * appended for the entry not committed yet.  tail <= head <= write.
+     */
+    size_t tail;
+    size_t head;
+    size_t write;
+};
+
+extern bool aesd_circular_arena_init(struct aesd_circular_arena *arena, char *data, size_t data_size,
+            struct aesd_arena_entry *entries, uint32_t nr_entries);
+
+extern size_t aesd_circular_arena_reserve(struct aesd_circular_arena *arena, size_t len,
+            struct aesd_arena_span span[2]);
+
+extern void aesd_circular_arena_produce(struct aesd_circular_arena *arena, size_t len);
+
+extern bool aesd_circular_arena_append(struct aesd_circular_arena *arena, const char *buf, size_t len);
+
+extern void aesd_circular_arena_commit(struct aesd_circular_arena *arena);
+
+extern void aesd_circular_arena_discard(struct aesd_circular_arena *arena);
+
+extern size_t aesd_circular_arena_entry_count(struct aesd_circular_arena *arena);
+
+extern size_t aesd_circular_arena_calculate_size(struct aesd_circular_arena *arena);
+
+extern bool aesd_circular_arena_fpos_for_entry(struct aesd_circular_arena *arena, size_t entry_index,
+            size_t entry_offset, size_t *fpos_rtn);
+
+extern size_t aesd_circular_arena_spans(struct aesd_circular_arena *arena, size_t char_offset, size_t len,
+            struct aesd_arena_span span[2]);
+
+extern size_t aesd_circular_arena_read(struct aesd_circular_arena *arena, size_t char_offset, char *buf, size_t len);
+
+#endif /* AESD_CIRCULAR_ARENA_H */
@@ -0,0 +1,206 @@
+/**
+ * @file aesd-circular-atomic.c
+ * @brief Lock-free circular buffer with seqlock protected slots
+ *
+ * See aesd-circular-atomic.h for the protocol.  All shared state, payload
+ * included, is only accessed through atomics so readers racing a producer
+ * never perform a plain data race, the sequence word tells them afterwards
+ * whether what they copied is valid.
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aesd-circular-atomic.h"
+
+#define WORD_SIZE sizeof(uint64_t)
+
+/* Sequence word value of slot holding the complete entry seq */
+static inline uint64_t seq_done(uint64_t seq){
+    return (2 * seq) + 2;
+}
+
+/**
+* Allocates a ring of @param capacity slots, each holding entries of up to @param max_entry_size bytes.
+* @param capacity a power of two, at most 2^31
+* @return the ring, or NULL if arguments are invalid or memory is exhausted
+*/
+struct aesd_atomic_ring *aesd_atomic_ring_create(uint32_t capacity, size_t max_entry_size,
+            enum aesd_atomic_mode mode){
+    struct aesd_atomic_ring *ring;
+
+    if( (capacity == 0) || (capacity > (1U << 31)) || ((capacity & (capacity - 1)) != 0) || (max_entry_size == 0) ){
+        return NULL;
+    }
+
+    if( (ring = calloc(1, sizeof(struct aesd_atomic_ring))) == NULL ){
+        return NULL;
+    }
+    ring->mode = mode;
+    ring->mask = capacity - 1;
+    ring->slot_words = (max_entry_size + WORD_SIZE - 1) / WORD_SIZE;
+    atomic_init(&ring->head, 0);
+    ring->seq = calloc(capacity, sizeof(*ring->seq));
+    ring->size = calloc(capacity, sizeof(*ring->size));
+    ring->data = calloc((size_t)capacity * ring->slot_words, sizeof(*ring->data));
+    if( (ring->seq == NULL) || (ring->size == NULL) || (ring->data == NULL) ){
+        aesd_atomic_ring_destroy(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+/**
+* Frees @param ring, no other thread may use it any more
+*/
+void aesd_atomic_ring_destroy(struct aesd_atomic_ring *ring){
+    if(ring == NULL){
+        return;
+    }
+    free(ring->seq);
+    free(ring->size);
+    free(ring->data);
+    free(ring);
+}
+
+/**
+* Copies @param len bytes of @param buf into the ring as a new entry, overwriting the oldest one once
+* the ring is full.  Single producer rings must only call this from one thread at a time.
+* @param seq_rtn set to the sequence number of the new entry when not NULL
+* @return false if len exceeds the max_entry_size given at creation
+*/
+bool aesd_atomic_ring_add(struct aesd_atomic_ring *ring, const char *buf, size_t len, uint64_t *seq_rtn){
+    uint64_t seq, slot, word;
+    _Atomic uint64_t *data;
+    size_t i;
+
+    if(len > ring->slot_words * WORD_SIZE){
+        return false;
+    }
+
+    if(ring->mode == AESD_ATOMIC_MULTI_PRODUCER){
+        seq = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    }else{
+        seq = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    }
+    slot = seq & ring->mask;
+
+    // Producers sharing a slot take turns in sequence order: wait for the entry one lap back
+    if(ring->mode == AESD_ATOMIC_MULTI_PRODUCER){
+        uint64_t previous = (seq > ring->mask) ? seq_done(seq - ring->mask - 1) : 0;
+        while(atomic_load_explicit(&ring->seq[slot], memory_order_acquire) != previous){
+            sched_yield();
+        }
+    }
+
+    // Odd sequence word while writing, readers racing this discard their copy
+    atomic_store_explicit(&ring->seq[slot], (2 * seq) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&ring->size[slot], len, memory_order_relaxed);
+    data = &ring->data[slot * ring->slot_words];
+    for(i = 0; i * WORD_SIZE < len; i++){
+        size_t chunk = (len - (i * WORD_SIZE) < WORD_SIZE) ? len - (i * WORD_SIZE) : WORD_SIZE;
+        word = 0;
+        memcpy(&word, buf + (i * WORD_SIZE), chunk);
+        atomic_store_explicit(&data[i], word, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&ring->seq[slot], seq_done(seq), memory_order_release);
+    if(ring->mode == AESD_ATOMIC_SINGLE_PRODUCER){
+        atomic_store_explicit(&ring->head, seq + 1, memory_order_release);
+    }
+
+    if(seq_rtn != NULL){
+        *seq_rtn = seq;
+    }
+    return true;
+}
+
+/**
+* Copies entry @param seq out of @param ring without taking any lock.
+* @param buf receives the payload, @param buf_len bytes large
+* @param size_rtn set to the entry size on AESD_ATOMIC_OK and AESD_ATOMIC_TRUNCATED
+* @return AESD_ATOMIC_OK with a consistent copy, or why there is none
+*/
+enum aesd_atomic_status aesd_atomic_ring_read(struct aesd_atomic_ring *ring, uint64_t seq,
+            char *buf, size_t buf_len, size_t *size_rtn){
+    uint64_t slot = seq & ring->mask;
+    uint64_t before, after, word;
+    _Atomic uint64_t *data;
+    size_t size, i;
+
+    before = atomic_load_explicit(&ring->seq[slot], memory_order_acquire);
+    if(before < seq_done(seq)){
+        return AESD_ATOMIC_AGAIN;
+    }
+    if(before > seq_done(seq)){
+        return AESD_ATOMIC_OVERWRITTEN;
+    }
+
+    size = atomic_load_explicit(&ring->size[slot], memory_order_relaxed);
+    if(size <= buf_len){
+        data = &ring->data[slot * ring->slot_words];
+        for(i = 0; i * WORD_SIZE < size; i++){
+            size_t chunk = (size - (i * WORD_SIZE) < WORD_SIZE) ? size - (i * WORD_SIZE) : WORD_SIZE;
+            word = atomic_load_explicit(&data[i], memory_order_relaxed);
+            memcpy(buf + (i * WORD_SIZE), &word, chunk);
+        }
+    }
+
+    // Anything copied after the producer started the next lap is torn
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&ring->seq[slot], memory_order_relaxed);
+    if(after != before){
+        return AESD_ATOMIC_OVERWRITTEN;
+    }
+
+    *size_rtn = size;
+    return (size <= buf_len) ? AESD_ATOMIC_OK : AESD_ATOMIC_TRUNCATED;
+}
+
+/**
+* @return the sequence number the next entry added to @param ring gets.  With multiple producers
+* entries just below it may still be in flight.
+*/
+uint64_t aesd_atomic_ring_head(struct aesd_atomic_ring *ring){
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+/**
+* Points @param cursor at the oldest entry currently held by @param ring
+*/
+void aesd_atomic_cursor_init(struct aesd_atomic_ring *ring, struct aesd_atomic_cursor *cursor){
+    uint64_t head = aesd_atomic_ring_head(ring);
+
+    cursor->next = (head > ring->mask) ? head - ring->mask - 1 : 0;
+    cursor->lost = 0;
+}
+
+/**
+* Reads the entry at @param cursor and advances it.  Entries overwritten before they could be read are
+* skipped and counted in cursor->lost.
+* @return AESD_ATOMIC_OK with the next entry copied, AESD_ATOMIC_AGAIN when the reader caught up with the
+* producers, or AESD_ATOMIC_TRUNCATED (cursor not advanced) when buf is too small
+*/
+enum aesd_atomic_status aesd_atomic_ring_next(struct aesd_atomic_ring *ring, struct aesd_atomic_cursor *cursor,
+            char *buf, size_t buf_len, size_t *size_rtn){
+    enum aesd_atomic_status status;
+
+    while( (status = aesd_atomic_ring_read(ring, cursor->next, buf, buf_len, size_rtn)) == AESD_ATOMIC_OVERWRITTEN ){
+        uint64_t head = aesd_atomic_ring_head(ring);
+        uint64_t oldest = (head > ring->mask) ? head - ring->mask - 1 : 0;
+
+        // Resume at the oldest entry still held, at least one past the lost one
+        if(oldest <= cursor->next){
+            oldest = cursor->next + 1;
+        }
+        cursor->lost += oldest - cursor->next;
+        cursor->next = oldest;
+    }
+
+    if(status == AESD_ATOMIC_OK){
+        cursor->next++;
+    }
+    return status;
+}
@@ -0,0 +1,93 @@
+/*
+ * aesd-circular-atomic.h
+ *
+ *  @brief Lock-free circular buffer variant for userspace, built on C11 atomics
+ *
+ *  aesd_circular_buffer leaves all locking to its callers.  This variant lets
+ *  producers and readers share a ring without any lock.  Every entry added
+ *  gets the next sequence number n and goes to slot n & mask, overwriting
+ *  entry n - capacity.  Each slot carries a sequence word working like a
+ *  seqlock: odd while entry n is being written, 2n + 2 once complete.
+ *  Readers copy an entry out and re-check the word, a changed word means the
+ *  entry was overwritten meanwhile and the copy is discarded.  Payloads are
+ *  copied into the ring (up to max_entry_size bytes per entry), so readers
+ *  never follow pointers into memory a producer may have freed.
+ *
+ *  Readers are independent: each one keeps its own cursor and sees every
+ *  entry still in the ring, nothing is consumed.
+ *
+ *  AESD_ATOMIC_SINGLE_PRODUCER rings expect one writer thread at a time,
+ *  AESD_ATOMIC_MULTI_PRODUCER rings let any number of threads add entries.
+ */
+
+#ifndef AESD_CIRCULAR_ATOMIC_H
+#define AESD_CIRCULAR_ATOMIC_H
+
+#ifdef __KERNEL__
+#error "aesd-circular-atomic is a userspace variant, the driver uses aesd-circular-buffer"
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum aesd_atomic_mode {
+    AESD_ATOMIC_SINGLE_PRODUCER,
+    AESD_ATOMIC_MULTI_PRODUCER,
+};
+
+/* Results of reading an entry */
+enum aesd_atomic_status {
+    /* Entry copied out */
+    AESD_ATOMIC_OK,
+    /* Entry not added yet, or still being written */
+    AESD_ATOMIC_AGAIN,
+    /* Entry overwritten by a newer one before or while it was read */
+    AESD_ATOMIC_OVERWRITTEN,
+    /* Entry larger than the caller buffer, nothing copied */
+    AESD_ATOMIC_TRUNCATED,
+};
+
+struct aesd_atomic_ring
+{
+    enum aesd_atomic_mode mode;
+    /* Number of slots minus one, a power of two minus one */
+    uint64_t mask;
+    /* Payload words per slot */
+    size_t slot_words;
+    /* Sequence number the next added entry gets */
+    _Atomic uint64_t head;
+    /* Per slot: seqlock word, entry size and payload words */
+    _Atomic uint64_t *seq;
+    _Atomic size_t *size;
+    _Atomic uint64_t *data;
+};
+
+/* Reader position, one per reader thread */
+struct aesd_atomic_cursor
+{
+    /* Sequence number of the next entry to read */
+    uint64_t next;
+    /* Entries overwritten before this reader got to them */
+    uint64_t lost;
+};
+
+extern struct aesd_atomic_ring *aesd_atomic_ring_create(uint32_t capacity, size_t max_entry_size,
+            enum aesd_atomic_mode mode);
+
+extern void aesd_atomic_ring_destroy(struct aesd_atomic_ring *ring);
+
+extern bool aesd_atomic_ring_add(struct aesd_atomic_ring *ring, const char *buf, size_t len, uint64_t *seq_rtn);
+
+extern enum aesd_atomic_status aesd_atomic_ring_read(struct aesd_atomic_ring *ring, uint64_t seq,
+            char *buf, size_t buf_len, size_t *size_rtn);
+
+extern uint64_t aesd_atomic_ring_head(struct aesd_atomic_ring *ring);
+
+extern void aesd_atomic_cursor_init(struct aesd_atomic_ring *ring, struct aesd_atomic_cursor *cursor);
+
+extern enum aesd_atomic_status aesd_atomic_ring_next(struct aesd_atomic_ring *ring, struct aesd_atomic_cursor *cursor,
+            char *buf, size_t buf_len, size_t *size_rtn);
+
+#endif /* AESD_CIRCULAR_ATOMIC_H */
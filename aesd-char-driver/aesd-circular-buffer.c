@@ -11,23 +11,66 @@
 #ifdef __KERNEL__
     #include <linux/string.h>
     #include <linux/types.h>
+    #include <linux/ktime.h>
 #else
+    #define _POSIX_C_SOURCE 200809L
     #include <string.h>
     #include <stddef.h>
+    #include <time.h>
 #endif
 
 #include "aesd-circular-buffer.h"
 
-loff_t aesd_circular_buffer_calculate_size(struct aesd_circular_buffer *buffer){
-    size_t total_size = 0;
-    size_t count = buffer->full ? AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED : buffer->in_offs;
+/**
+* @return the wall clock time in ns since the epoch
+*/
+static uint64_t aesd_circular_buffer_clock(void){
+#ifdef __KERNEL__
+    return ktime_get_real_ns();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+#endif
+}
+
+/**
+* @return the number of entries currently stored in @param buffer
+*/
+size_t aesd_circular_buffer_entry_count(struct aesd_circular_buffer *buffer){
+    if(buffer->full){
+        return buffer->capacity;
+    }
+    return (buffer->in_offs - buffer->out_offs) & buffer->mask;
+}
+
+/**
+* @return the total number of bytes stored in @param buffer, maintained by aesd_circular_buffer_add_entry()
+*/
+size_t aesd_circular_buffer_calculate_size(struct aesd_circular_buffer *buffer){
+    return buffer->total_size;
+}
+
+/**
+* Translates a zero referenced entry index (oldest entry first) and a byte offset within it into
+* the matching char_offset of the concatenated buffer contents.
+* @return true and sets @param fpos_rtn when entry_index and entry_offset are within the buffer, false otherwise
+*/
+bool aesd_circular_buffer_fpos_for_entry(struct aesd_circular_buffer *buffer, size_t entry_index,
+            size_t entry_offset, size_t *fpos_rtn){
+    struct aesd_buffer_entry *entry;
 
-    for(size_t i = 0; i < count; i++){
-        size_t entry_pos = (buffer->out_offs + i) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-        total_size += buffer->entry[entry_pos].size;
+    if(entry_index >= aesd_circular_buffer_entry_count(buffer)){
+        return false;
     }
 
-    return total_size;
+    entry = &buffer->entry[(buffer->out_offs + entry_index) & buffer->mask];
+    if(entry_offset >= entry->size){
+        return false;
+    }
+
+    *fpos_rtn = (entry->cumulative_offs - buffer->entry[buffer->out_offs].cumulative_offs) + entry_offset;
+    return true;
 }
 
 /**
@@ -43,49 +86,477 @@ loff_t aesd_circular_buffer_calculate_size(struct aesd_circular_buffer *buffer){
 struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct aesd_circular_buffer *buffer,
             size_t char_offset, size_t *entry_offset_byte_rtn ){
 
-    size_t remaining = char_offset;
-    size_t count = buffer->full ? AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED : buffer->in_offs;
-    
-    for (size_t i = 0; i < count; i++){
-        size_t entry_pos = (buffer->out_offs + i) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-        if (remaining < buffer->entry[entry_pos].size){
-            *entry_offset_byte_rtn = remaining;
-            return &buffer->entry[entry_pos];
+    size_t base, low, high;
+    struct aesd_buffer_entry *entry;
+
+    if(char_offset >= buffer->total_size){
+        return NULL;
+    }
+
+    /*
+     * Cumulative offsets grow with the entry index, binary search for the last entry
+     * starting at or before char_offset.  Zero sized entries share their start with
+     * the following entry and are never selected.
+     */
+    base = buffer->entry[buffer->out_offs].cumulative_offs;
+    low = 0;
+    high = aesd_circular_buffer_entry_count(buffer) - 1;
+    while(low < high){
+        size_t mid = low + ((high - low + 1) / 2);
+        entry = &buffer->entry[(buffer->out_offs + mid) & buffer->mask];
+        if((entry->cumulative_offs - base) <= char_offset){
+            low = mid;
+        }else{
+            high = mid - 1;
+        }
+    }
+
+    entry = &buffer->entry[(buffer->out_offs + low) & buffer->mask];
+    *entry_offset_byte_rtn = char_offset - (entry->cumulative_offs - base);
+    return entry;
+}
+
+/**
+* Removes the oldest entry of @param buffer, copying it to @param evicted when not NULL.
+* The slot is cleared so AESD_CIRCULAR_BUFFER_FOREACH only sees live entries.
+*/
+static void aesd_circular_buffer_remove_oldest(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *evicted){
+    struct aesd_buffer_entry *oldest = &buffer->entry[buffer->out_offs];
+
+    if(evicted != NULL){
+        *evicted = *oldest;
+    }
+    buffer->total_size -= oldest->size;
+    oldest->buffptr = NULL;
+    oldest->size = 0;
+    buffer->out_offs = (buffer->out_offs + 1) & buffer->mask;
+    buffer->full = false;
+}
+
+/**
+* @return true if @param buffer holding @param extra_entries more entries of @param extra_bytes would
+* exceed its entry count or byte budget
+*/
+static bool aesd_circular_buffer_over_limits(struct aesd_circular_buffer *buffer, size_t extra_bytes, uint32_t extra_entries){
+    size_t count = aesd_circular_buffer_entry_count(buffer) + extra_entries;
+    uint32_t max_entries = buffer->capacity;
+
+    if( (buffer->max_entries != 0) && (buffer->max_entries < max_entries) ){
+        max_entries = buffer->max_entries;
+    }
+    if(count > max_entries){
+        return true;
+    }
+    return (buffer->max_bytes != 0) && ((buffer->total_size + extra_bytes) > buffer->max_bytes);
+}
+
+/**
+* Finds the first entry with a sequence number at or after @param seq.  Sequence numbers of stored
+* entries are consecutive, so this is a direct index computation.
+* @param fpos_rtn set to the char_offset of the entry's first byte
+* @return the entry, or NULL when @param seq is newer than every stored entry
+*/
+struct aesd_buffer_entry *aesd_circular_buffer_find_entry_for_seq(struct aesd_circular_buffer *buffer,
+            uint64_t seq, size_t *fpos_rtn){
+    struct aesd_buffer_entry *oldest, *entry;
+    size_t count = aesd_circular_buffer_entry_count(buffer);
+
+    if( (count == 0) || (seq >= buffer->next_seq) ){
+        return NULL;
+    }
+
+    oldest = &buffer->entry[buffer->out_offs];
+    entry = (seq <= oldest->seq) ? oldest : &buffer->entry[(buffer->out_offs + (seq - oldest->seq)) & buffer->mask];
+    *fpos_rtn = entry->cumulative_offs - oldest->cumulative_offs;
+    return entry;
+}
+
+/**
+* Finds the first entry added at or after @param timestamp (ns since the epoch) with a binary search,
+* entry timestamps never decrease.
+* @param fpos_rtn set to the char_offset of the entry's first byte
+* @return the entry, or NULL when every stored entry is older than @param timestamp
+*/
+struct aesd_buffer_entry *aesd_circular_buffer_find_entry_for_time(struct aesd_circular_buffer *buffer,
+            uint64_t timestamp, size_t *fpos_rtn){
+    size_t low = 0, high = aesd_circular_buffer_entry_count(buffer);
+    struct aesd_buffer_entry *entry;
+
+    // Lower bound: first of the entries in [low, high) with an entry timestamp >= timestamp
+    while(low < high){
+        size_t mid = low + ((high - low) / 2);
+        entry = &buffer->entry[(buffer->out_offs + mid) & buffer->mask];
+        if(entry->timestamp < timestamp){
+            low = mid + 1;
+        }else{
+            high = mid;
         }
-        remaining -= buffer->entry[entry_pos].size;
     }
-    
-    return NULL;
+    if(low == aesd_circular_buffer_entry_count(buffer)){
+        return NULL;
+    }
+
+    entry = &buffer->entry[(buffer->out_offs + low) & buffer->mask];
+    *fpos_rtn = entry->cumulative_offs - buffer->entry[buffer->out_offs].cumulative_offs;
+    return entry;
+}
+
+/**
+* Adds entry @param add_entry to @param buffer in the location specified in buffer->in_offs, first evicting
+* the oldest entries until the buffer has room for it under its entry count and byte limits.  The new entry
+* is always stored, even when it alone exceeds the byte budget.
+* Any necessary locking must be handled by the caller
+* Any memory referenced in @param add_entry must be allocated by and/or must have a lifetime managed by the caller.
+* The stored copy gets its cumulative_offs, seq and timestamp assigned here; the values passed in are ignored.
+* @param evicted array receiving the evicted entries oldest first, so the caller can release their memory
+*      after dropping its lock.  NULL drops evicted entries without reporting them.
+* @param evicted_max number of entries evicted can hold, at least 1 when evicted is not NULL.  When it fills up
+*      before the byte budget is met the buffer is left over budget, call aesd_circular_buffer_evict() to finish.
+* @return the number of entries stored in evicted (or dropped when evicted is NULL)
+*/
+size_t aesd_circular_buffer_add_entry_evict(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry,
+            struct aesd_buffer_entry *evicted, size_t evicted_max){
+    uint32_t index;
+    uint64_t timestamp;
+    size_t nr_evicted = 0;
+
+    while( (aesd_circular_buffer_entry_count(buffer) > 0) &&
+            ((evicted == NULL) || (nr_evicted < evicted_max)) &&
+            aesd_circular_buffer_over_limits(buffer, add_entry->size, 1) ){
+        aesd_circular_buffer_remove_oldest(buffer, (evicted != NULL) ? &evicted[nr_evicted] : NULL);
+        nr_evicted++;
+    }
+
+    index = buffer->in_offs;
+    buffer->entry[index] = *add_entry;
+    buffer->entry[index].cumulative_offs = buffer->cumulative_offs;
+    buffer->entry[index].seq = buffer->next_seq++;
+    timestamp = aesd_circular_buffer_clock();
+    if(timestamp > buffer->last_timestamp){
+        buffer->last_timestamp = timestamp;
+    }
+    buffer->entry[index].timestamp = buffer->last_timestamp;
+    buffer->cumulative_offs += add_entry->size;
+    buffer->total_size += add_entry->size;
+
+    buffer->in_offs = (index + 1) & buffer->mask;
+
+    // Verify if circular buffer still has empty slots
+    if(((buffer->in_offs - buffer->out_offs) & buffer->mask) == (buffer->capacity & buffer->mask)){
+        buffer->full = true;
+    }
+    return nr_evicted;
 }
 
 /**
 * Adds entry @param add_entry to @param buffer in the location specified in buffer->in_offs.
-* If the buffer was already full, overwrites the oldest entry and advances buffer->out_offs to the
-* new start location.
+* If the buffer was already full, overwrites the oldest entry (the one at buffer->out_offs) and advances
+* buffer->out_offs to the new start location, also dropping old entries as needed to respect limits set
+* with aesd_circular_buffer_set_limits().
 * Any necessary locking must be handled by the caller
 * Any memory referenced in @param add_entry must be allocated by and/or must have a lifetime managed by the caller.
+* The stored copy gets its cumulative_offs, seq and timestamp assigned here; the values passed in are ignored.
 */
 void aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry){
-   size_t index = buffer->in_offs;
+    aesd_circular_buffer_add_entry_evict(buffer, add_entry, NULL, 0);
+}
 
-   if(buffer->full == true){
-    buffer->out_offs = (index + 1) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-   }
+/**
+* Evicts the oldest entries of @param buffer while it exceeds its limits, for instance after they were
+* lowered or when aesd_circular_buffer_add_entry_evict() ran out of room in its evicted array.
+* The newest entry is never evicted.
+* @param evicted array receiving the evicted entries oldest first, NULL drops them
+* @param evicted_max number of entries evicted can hold
+* @return the number of entries evicted, equal to evicted_max when more may remain over the limits
+*/
+size_t aesd_circular_buffer_evict(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *evicted, size_t evicted_max){
+    size_t nr_evicted = 0;
 
-   buffer->entry[index] = *add_entry;
+    while( (aesd_circular_buffer_entry_count(buffer) > 1) &&
+            ((evicted == NULL) || (nr_evicted < evicted_max)) &&
+            aesd_circular_buffer_over_limits(buffer, 0, 0) ){
+        aesd_circular_buffer_remove_oldest(buffer, (evicted != NULL) ? &evicted[nr_evicted] : NULL);
+        nr_evicted++;
+    }
+    return nr_evicted;
+}
 
-   buffer->in_offs = (index + 1) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+/**
+* Evicts up to @param evicted_max of the oldest entries of @param buffer regardless of its limits, to give
+* memory back under pressure.  The newest entry is never evicted.
+* @param evicted array receiving the evicted entries oldest first
+* @return the number of entries evicted
+*/
+size_t aesd_circular_buffer_evict_oldest(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *evicted, size_t evicted_max){
+    size_t nr_evicted = 0;
+
+    while( (aesd_circular_buffer_entry_count(buffer) > 1) && (nr_evicted < evicted_max) ){
+        aesd_circular_buffer_remove_oldest(buffer, &evicted[nr_evicted]);
+        nr_evicted++;
+    }
+    return nr_evicted;
+}
+
+/**
+* Adds @param nr_entries entries of @param add_entries to @param buffer in order, like as many calls to
+* aesd_circular_buffer_add_entry_evict() sharing one evicted array.
+* @param evicted array receiving the evicted entries oldest first, NULL drops them
+* @param evicted_max number of entries evicted can hold.  Adding stops early, before an entry that would
+*      need to evict with evicted already full, so no evicted entry is ever lost.
+* @param nr_evicted_rtn set to the number of entries stored in evicted
+* @return the number of entries added, the caller retries the rest after releasing the evicted ones
+*/
+size_t aesd_circular_buffer_add_entries(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entries,
+            size_t nr_entries, struct aesd_buffer_entry *evicted, size_t evicted_max, size_t *nr_evicted_rtn){
+    size_t added, nr_evicted = 0;
+
+    for(added = 0; added < nr_entries; added++){
+        if(evicted == NULL){
+            nr_evicted += aesd_circular_buffer_add_entry_evict(buffer, &add_entries[added], NULL, 0);
+            continue;
+        }
+        if( (nr_evicted == evicted_max) && (aesd_circular_buffer_entry_count(buffer) > 0) &&
+                aesd_circular_buffer_over_limits(buffer, add_entries[added].size, 1) ){
+            break;
+        }
+        nr_evicted += aesd_circular_buffer_add_entry_evict(buffer, &add_entries[added],
+                &evicted[nr_evicted], evicted_max - nr_evicted);
+    }
+
+    *nr_evicted_rtn = nr_evicted;
+    return added;
+}
+
+/**
+* Describes up to @param len bytes of @param buffer starting at @param char_offset with one scatter-gather
+* element per entry, ready for writev()/sendmsg() (or an iov_iter over kvecs in the kernel), without copying.
+* The elements point into the entries and stay valid until those entries are evicted.
+* @param iov caller array of @param iov_max elements
+* @param bytes_rtn set to the number of bytes described, less than len when the buffer ends or iov is full
+* @return the number of elements filled, 0 when char_offset is at or past the end of the buffer
+*/
+size_t aesd_circular_buffer_fill_iovec(struct aesd_circular_buffer *buffer, size_t char_offset, size_t len,
+            struct aesd_iovec *iov, size_t iov_max, size_t *bytes_rtn){
+    struct aesd_buffer_entry *entry;
+    size_t entry_offset, index, count, nr_iov = 0, bytes = 0;
+
+    entry = aesd_circular_buffer_find_entry_offset_for_fpos(buffer, char_offset, &entry_offset);
+    if(entry != NULL){
+        // Entries from the one holding char_offset up to the newest
+        index = (uint32_t)(entry - buffer->entry);
+        count = aesd_circular_buffer_entry_count(buffer) - ((index - buffer->out_offs) & buffer->mask);
+
+        while( (count > 0) && (nr_iov < iov_max) && (bytes < len) ){
+            size_t chunk = buffer->entry[index].size - entry_offset;
 
-   // Verify if circular buffer still has empty slots
-   if(!(buffer->full) && (buffer->in_offs == buffer->out_offs)){
-    buffer->full = true;
-   }
+            if(chunk > len - bytes){
+                chunk = len - bytes;
+            }
+            if(chunk > 0){
+                iov[nr_iov].iov_base = (void *)(buffer->entry[index].buffptr + entry_offset);
+                iov[nr_iov].iov_len = chunk;
+                nr_iov++;
+                bytes += chunk;
+            }
+            entry_offset = 0;
+            index = (index + 1) & buffer->mask;
+            count--;
+        }
+    }
+
+    *bytes_rtn = bytes;
+    return nr_iov;
+}
+
+/**
+* Like aesd_circular_buffer_fill_iovec(), but starts @param entry_offset bytes into the entry with sequence
+* number @param seq instead of at a char_offset, which moves whenever the oldest entries are evicted.
+* A start at the end of an entry moves on to the next one, and on return *seq and *entry_offset give where
+* the first element starts.  Element i describes the entry with sequence number *seq + i.
+* @return the number of elements filled, 0 when the entry was evicted or nothing is stored from there on
+*/
+size_t aesd_circular_buffer_fill_iovec_seq(struct aesd_circular_buffer *buffer, uint64_t *seq, size_t *entry_offset,
+            size_t len, struct aesd_iovec *iov, size_t iov_max, size_t *bytes_rtn){
+    struct aesd_buffer_entry *entry;
+    size_t fpos, index, count, offset = *entry_offset, nr_iov = 0, bytes = 0;
+
+    *bytes_rtn = 0;
+    entry = aesd_circular_buffer_find_entry_for_seq(buffer, *seq, &fpos);
+    if( (entry == NULL) || (entry->seq != *seq) ){
+        return 0;
+    }
+    index = (uint32_t)(entry - buffer->entry);
+    count = buffer->next_seq - *seq;
+
+    while( (count > 0) && (nr_iov < iov_max) && (bytes < len) ){
+        size_t chunk = (buffer->entry[index].size > offset) ? (buffer->entry[index].size - offset) : 0;
+
+        if(chunk > len - bytes){
+            chunk = len - bytes;
+        }
+        // Only a start already read to its end is skipped, later elements keep their one to one seq mapping
+        if( (chunk > 0) || (nr_iov > 0) ){
+            if(nr_iov == 0){
+                *seq = buffer->entry[index].seq;
+                *entry_offset = offset;
+            }
+            iov[nr_iov].iov_base = (void *)(buffer->entry[index].buffptr + offset);
+            iov[nr_iov].iov_len = chunk;
+            nr_iov++;
+            bytes += chunk;
+        }
+        offset = 0;
+        index = (index + 1) & buffer->mask;
+        count--;
+    }
+
+    *bytes_rtn = bytes;
+    return nr_iov;
 }
 
 /**
-* Initializes the circular buffer described by @param buffer to an empty struct
+* Describes @param buffer as the header and entry table of a snapshot image.  The payload part follows
+* the table, aesd_circular_buffer_fill_iovec() from offset 0 gives it without copying.
+* @param header filled in here
+* @param table caller array of @param table_max elements, at least aesd_circular_buffer_entry_count() of them
+* @return the number of table elements filled, 0 when the buffer is empty or table is too small
+*/
+size_t aesd_circular_buffer_snapshot(struct aesd_circular_buffer *buffer, struct aesd_snapshot_header *header,
+            struct aesd_snapshot_entry *table, size_t table_max){
+    size_t i, count = aesd_circular_buffer_entry_count(buffer);
+
+    memset(header, 0, sizeof(struct aesd_snapshot_header));
+    header->magic = AESD_SNAPSHOT_MAGIC;
+    header->version = AESD_SNAPSHOT_VERSION;
+    if( (count == 0) || (count > table_max) ){
+        header->first_seq = buffer->next_seq;
+        return 0;
+    }
+
+    header->nr_entries = count;
+    header->first_seq = buffer->entry[buffer->out_offs].seq;
+    header->payload_size = buffer->total_size;
+    for(i = 0; i < count; i++){
+        struct aesd_buffer_entry *entry = &buffer->entry[(buffer->out_offs + i) & buffer->mask];
+        table[i].size = entry->size;
+        table[i].timestamp = entry->timestamp;
+    }
+    return count;
+}
+
+/**
+* Fills the empty @param buffer from the snapshot image at @param image in one pass, keeping the newest
+* entries that fit its capacity and limits along with their sequence numbers and timestamps.
+* Entries point into the image: it must stay mapped, unchanged, for as long as they are in the buffer.
+* @param image_len bytes available at image, the image may be followed by unrelated data
+* @return true on success, false leaving @param buffer untouched if it isn't empty or the image is invalid
+*/
+bool aesd_circular_buffer_restore(struct aesd_circular_buffer *buffer, const void *image, size_t image_len){
+    const struct aesd_snapshot_header *header = image;
+    const struct aesd_snapshot_entry *table;
+    const char *payload;
+    size_t table_len, payload_size = 0, kept_bytes = 0, offset, limit;
+    uint32_t i, first;
+
+    if( (aesd_circular_buffer_entry_count(buffer) != 0) || (image_len < sizeof(struct aesd_snapshot_header)) ||
+            (header->magic != AESD_SNAPSHOT_MAGIC) || (header->version != AESD_SNAPSHOT_VERSION) ){
+        return false;
+    }
+    table = (const struct aesd_snapshot_entry *)(header + 1);
+    if(header->nr_entries > (image_len - sizeof(struct aesd_snapshot_header)) / sizeof(struct aesd_snapshot_entry)){
+        return false;
+    }
+    table_len = (size_t)header->nr_entries * sizeof(struct aesd_snapshot_entry);
+    for(i = 0; i < header->nr_entries; i++){
+        if(table[i].size > image_len - payload_size){
+            return false;
+        }
+        payload_size += table[i].size;
+    }
+    if( (payload_size != header->payload_size) ||
+            (payload_size > image_len - sizeof(struct aesd_snapshot_header) - table_len) ){
+        return false;
+    }
+    payload = (const char *)table + table_len;
+
+    // Newest entries first until the capacity or a limit is reached, the newest one is always kept
+    limit = buffer->capacity;
+    if( (buffer->max_entries != 0) && (buffer->max_entries < limit) ){
+        limit = buffer->max_entries;
+    }
+    for(first = header->nr_entries; first > 0; first--){
+        size_t size = table[first - 1].size;
+        if( (first < header->nr_entries) && ((header->nr_entries - first == limit) ||
+                ((buffer->max_bytes != 0) && (size > buffer->max_bytes - kept_bytes))) ){
+            break;
+        }
+        kept_bytes += size;
+    }
+
+    offset = payload_size - kept_bytes;
+    buffer->next_seq = header->first_seq + first;
+    for(i = first; i < header->nr_entries; i++){
+        struct aesd_buffer_entry *entry = &buffer->entry[buffer->in_offs];
+
+        entry->buffptr = payload + offset;
+        entry->size = table[i].size;
+        entry->cumulative_offs = buffer->cumulative_offs;
+        entry->seq = buffer->next_seq++;
+        // Clamped like aesd_circular_buffer_add_entry_evict() so time lookups stay ordered
+        if(table[i].timestamp > buffer->last_timestamp){
+            buffer->last_timestamp = table[i].timestamp;
+        }
+        entry->timestamp = buffer->last_timestamp;
+        buffer->cumulative_offs += table[i].size;
+        offset += table[i].size;
+        buffer->in_offs = (buffer->in_offs + 1) & buffer->mask;
+    }
+    buffer->total_size = kept_bytes;
+    buffer->full = (header->nr_entries - first == buffer->capacity);
+    return true;
+}
+
+/**
+* Sets the eviction limits of @param buffer, applied by the next add or aesd_circular_buffer_evict() call.
+* @param max_bytes byte budget for the total size of all entries, 0 for none
+* @param max_entries number of entries kept, 0 or anything above the capacity keeps the capacity
+*/
+void aesd_circular_buffer_set_limits(struct aesd_circular_buffer *buffer, size_t max_bytes, uint32_t max_entries){
+    buffer->max_bytes = max_bytes;
+    buffer->max_entries = max_entries;
+}
+
+/**
+* Initializes the circular buffer described by @param buffer to an empty struct holding up to
+* AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED entries in its embedded slots
 */
 void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer)
 {
     memset(buffer,0,sizeof(struct aesd_circular_buffer));
+    buffer->entry = buffer->entry_storage;
+    buffer->mask = AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS - 1;
+    buffer->capacity = AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+}
+
+/**
+* Initializes @param buffer to an empty struct keeping up to @param capacity entries in @param storage.
+* @param storage caller allocated array of capacity entries, cleared here and owned by the caller
+*      for the lifetime of the buffer.
+* @param capacity a power of two no larger than AESD_CIRCULAR_BUFFER_MAX_CAPACITY
+* @return true on success, false leaving @param buffer untouched if storage or capacity are invalid
+*/
+bool aesd_circular_buffer_init_capacity(struct aesd_circular_buffer *buffer,
+            struct aesd_buffer_entry *storage, uint32_t capacity)
+{
+    if( (storage == NULL) || (capacity == 0) || (capacity > AESD_CIRCULAR_BUFFER_MAX_CAPACITY) ||
+            ((capacity & (capacity - 1)) != 0) ){
+        return false;
+    }
+
+    memset(buffer,0,sizeof(struct aesd_circular_buffer));
+    memset(storage,0,(size_t)capacity * sizeof(struct aesd_buffer_entry));
+    buffer->entry = storage;
+    buffer->mask = capacity - 1;
+    buffer->capacity = capacity;
+    return true;
 }
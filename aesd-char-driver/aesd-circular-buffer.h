@@ -10,33 +10,109 @@
 
 #ifdef __KERNEL__
 #include <linux/types.h>
+#include <linux/uio.h>
+/* Scatter-gather element filled by aesd_circular_buffer_fill_iovec(), struct kvec in the kernel */
+#define aesd_iovec kvec
 #else
 #include <stddef.h> // size_t
 #include <stdint.h> // uintx_t
 #include <stdbool.h>
+#include <sys/uio.h>
+/* Scatter-gather element filled by aesd_circular_buffer_fill_iovec(), struct iovec for writev/sendmsg */
+#define aesd_iovec iovec
 #endif
 
 #define AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED 10
 
+/*
+ * Entry slots embedded in every buffer, the smallest power of two holding
+ * AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED entries.  Buffers set up with
+ * aesd_circular_buffer_init() keep that many entries in these slots.
+ */
+#define AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS 16
+
+/* Largest capacity accepted by aesd_circular_buffer_init_capacity() */
+#define AESD_CIRCULAR_BUFFER_MAX_CAPACITY (1U << 31)
+
 struct aesd_buffer_entry
 {
     /* A location where the buffer contents in buffptr are stored */
     const char *buffptr;
     /* Number of bytes stored in buffptr */
     size_t size;
+    /*
+     * Running byte count of the buffer when this entry was added, set by
+     * aesd_circular_buffer_add_entry().  Differences between entries give
+     * cumulative offsets; the count may wrap, only differences are meaningful.
+     */
+    size_t cumulative_offs;
+    /* Sequence number given by aesd_circular_buffer_add_entry(), one more than the previous entry's */
+    uint64_t seq;
+    /*
+     * Wall clock time of the add in ns since the epoch, set by aesd_circular_buffer_add_entry().
+     * Never lower than the previous entry's, so entries stay ordered if the clock steps back.
+     */
+    uint64_t timestamp;
 };
 
 struct aesd_circular_buffer
 {
-    
-    /* An array of pointers to memory allocated for the most recent write operations */
-    struct aesd_buffer_entry  entry[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED];
+    /*
+     * Entry slots for the most recent write operations, a power of two.
+     * Points at entry_storage unless caller storage was given at init.
+     */
+    struct aesd_buffer_entry *entry;
+    /* Number of entry slots minus one, slot indexes are masked with it */
+    uint32_t mask;
+    /* Number of entries kept before the oldest is overwritten, at most mask + 1 */
+    uint32_t capacity;
     /* The current location in the entry structure where the next write should be stored. */
-    uint8_t in_offs;
+    uint32_t in_offs;
     /* The first location in the entry structure to read from */
-    uint8_t out_offs;
+    uint32_t out_offs;
     /* Set to true when the buffer entry structure is full */
     bool full;
+    /* Total bytes of all entries currently in the buffer */
+    size_t total_size;
+    /* Running byte count assigned to the next entry added */
+    size_t cumulative_offs;
+    /* Sequence number and lowest timestamp for the next entry added */
+    uint64_t next_seq;
+    uint64_t last_timestamp;
+    /* Eviction limits set by aesd_circular_buffer_set_limits(), 0 when unused */
+    size_t max_bytes;
+    uint32_t max_entries;
+    /* Default slots used by aesd_circular_buffer_init() */
+    struct aesd_buffer_entry entry_storage[AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS];
+};
+
+/*
+ * Snapshot image of a buffer, laid out so a file holding one can be mmap'd and
+ * restored in place:
+ *   struct aesd_snapshot_header
+ *   struct aesd_snapshot_entry  table[nr_entries], oldest entry first
+ *   payload_size bytes          entry payloads back to back, in table order
+ * Fields are host endian with fixed widths, every part starts 8 byte aligned.
+ */
+#define AESD_SNAPSHOT_MAGIC 0x44534541 /* "AESD" read as a little endian uint32_t */
+#define AESD_SNAPSHOT_VERSION 1
+
+struct aesd_snapshot_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nr_entries;
+    uint32_t reserved;
+    /* Sequence number of the first table entry, the rest follow consecutively */
+    uint64_t first_seq;
+    /* Sum of all entry sizes, the length of the payload part */
+    uint64_t payload_size;
+};
+
+struct aesd_snapshot_entry
+{
+    uint64_t size;
+    uint64_t timestamp;
 };
 
 extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct aesd_circular_buffer *buffer,
@@ -44,18 +120,56 @@ extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos
 
 extern void aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry);
 
-extern loff_t aesd_circular_buffer_calculate_size(struct aesd_circular_buffer *buffer);
+extern size_t aesd_circular_buffer_add_entry_evict(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry,
+            struct aesd_buffer_entry *evicted, size_t evicted_max);
+
+extern size_t aesd_circular_buffer_evict(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *evicted, size_t evicted_max);
+
+extern size_t aesd_circular_buffer_evict_oldest(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *evicted, size_t evicted_max);
+
+extern void aesd_circular_buffer_set_limits(struct aesd_circular_buffer *buffer, size_t max_bytes, uint32_t max_entries);
+
+extern size_t aesd_circular_buffer_add_entries(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entries,
+            size_t nr_entries, struct aesd_buffer_entry *evicted, size_t evicted_max, size_t *nr_evicted_rtn);
+
+extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_for_seq(struct aesd_circular_buffer *buffer,
+            uint64_t seq, size_t *fpos_rtn);
+
+extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_for_time(struct aesd_circular_buffer *buffer,
+            uint64_t timestamp, size_t *fpos_rtn);
+
+extern size_t aesd_circular_buffer_fill_iovec(struct aesd_circular_buffer *buffer, size_t char_offset, size_t len,
+            struct aesd_iovec *iov, size_t iov_max, size_t *bytes_rtn);
+
+extern size_t aesd_circular_buffer_fill_iovec_seq(struct aesd_circular_buffer *buffer, uint64_t *seq, size_t *entry_offset,
+            size_t len, struct aesd_iovec *iov, size_t iov_max, size_t *bytes_rtn);
+
+extern size_t aesd_circular_buffer_snapshot(struct aesd_circular_buffer *buffer, struct aesd_snapshot_header *header,
+            struct aesd_snapshot_entry *table, size_t table_max);
+
+extern bool aesd_circular_buffer_restore(struct aesd_circular_buffer *buffer, const void *image, size_t image_len);
+
+extern size_t aesd_circular_buffer_calculate_size(struct aesd_circular_buffer *buffer);
 
 extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
 
+extern bool aesd_circular_buffer_init_capacity(struct aesd_circular_buffer *buffer,
+            struct aesd_buffer_entry *storage, uint32_t capacity);
+
+extern size_t aesd_circular_buffer_entry_count(struct aesd_circular_buffer *buffer);
+
+extern bool aesd_circular_buffer_fpos_for_entry(struct aesd_circular_buffer *buffer, size_t entry_index,
+            size_t entry_offset, size_t *fpos_rtn);
+
 /**
  * Create a for loop to iterate over each member of the circular buffer.
  * Useful when you've allocated memory for circular buffer entries and need to free it
+ * Visits every slot, including unused ones which have a NULL buffptr.
  * @param entryptr is a struct aesd_buffer_entry* to set with the current entry
  * @param buffer is the struct aesd_buffer * describing the buffer
- * @param index is a uint8_t stack allocated value used by this macro for an index
+ * @param index is a uint32_t stack allocated value used by this macro for an index
  * Example usage:
- * uint8_t index;
+ * uint32_t index;
  * struct aesd_circular_buffer buffer;
  * struct aesd_buffer_entry *entry;
  * AESD_CIRCULAR_BUFFER_FOREACH(entry,&buffer,index) {
@@ -64,7 +178,7 @@ extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
  */
 #define AESD_CIRCULAR_BUFFER_FOREACH(entryptr,buffer,index) \
     for(index=0, entryptr=&((buffer)->entry[index]); \
-            index<AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; \
+            index<=(buffer)->mask; \
             index++, entryptr=&((buffer)->entry[index]))
 
 
@@ -0,0 +1,254 @@
+/*
+ * aesd-ring.hpp
+ *
+ *  @brief Header-only C++17 counterpart of aesd_circular_buffer for userspace
+ *
+ *  aesd::ring<Entry, Capacity> keeps the semantics of aesd-circular-buffer.c:
+ *  the newest Capacity entries are kept, adding to a full ring overwrites the
+ *  oldest one, and byte positions ("fpos") address the entries as if they
+ *  were concatenated.  Differences from the C version:
+ *   - Capacity is a compile time power of two, indexes are masked.
+ *   - Entries are owned by the ring.  Any type with data() and size()
+ *     members works (std::string, std::vector<char>, aesd::entry); move-only
+ *     types are fine.  An overwritten entry is handed back to the caller, all
+ *     others are destroyed with the ring, so no cleanup loops.
+ *   - Iteration is a plain range, oldest to newest.
+ *   - Lookups return a std::string_view of the entry bytes from fpos on.
+ *  Like the C version it does no locking of its own.
+ */
+
+#ifndef AESD_RING_HPP
+#define AESD_RING_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace aesd {
+
+/**
+ * Move-only entry owning a copy of one write command
+ */
+class entry {
+public:
+    entry() = default;
+    entry(const char *data, std::size_t size) : data_(new char[size]), size_(size) {
+        std::memcpy(data_.get(), data, size);
+    }
+    explicit entry(std::string_view str) : entry(str.data(), str.size()) {}
+
+    entry(entry &&other) noexcept : data_(std::move(other.data_)), size_(std::exchange(other.size_, 0)) {}
+    entry &operator=(entry &&other) noexcept {
+        data_ = std::move(other.data_);
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+    entry(const entry &) = delete;
+    entry &operator=(const entry &) = delete;
+
+    const char *data() const noexcept { return data_.get(); }
+    std::size_t size() const noexcept { return size_; }
+
+private:
+    std::unique_ptr<char[]> data_;
+    std::size_t size_ = 0;
+};
+
+template <typename Entry, std::size_t Capacity>
+class ring {
+    static_assert((Capacity > 0) && ((Capacity & (Capacity - 1)) == 0), "ring capacity must be a power of two");
+    static_assert(std::is_nothrow_move_constructible_v<Entry>, "ring entries must be nothrow movable");
+
+public:
+    static constexpr std::size_t mask = Capacity - 1;
+
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const Entry *, Entry *>;
+        using reference = std::conditional_t<Const, const Entry &, Entry &>;
+        using ring_pointer = std::conditional_t<Const, const ring *, ring *>;
+
+        basic_iterator() = default;
+        basic_iterator(ring_pointer r, std::size_t index) noexcept : ring_(r), index_(index) {}
+
+        reference operator*() const noexcept { return ring_->at_slot(ring_->out_ + index_); }
+        pointer operator->() const noexcept { return &**this; }
+        reference operator[](difference_type n) const noexcept { return *(*this + n); }
+
+        basic_iterator &operator++() noexcept { ++index_; return *this; }
+        basic_iterator operator++(int) noexcept { basic_iterator tmp = *this; ++index_; return tmp; }
+        basic_iterator &operator--() noexcept { --index_; return *this; }
+        basic_iterator operator--(int) noexcept { basic_iterator tmp = *this; --index_; return tmp; }
+        basic_iterator &operator+=(difference_type n) noexcept { index_ += n; return *this; }
+        basic_iterator &operator-=(difference_type n) noexcept { index_ -= n; return *this; }
+        friend basic_iterator operator+(basic_iterator it, difference_type n) noexcept { return it += n; }
+        friend basic_iterator operator+(difference_type n, basic_iterator it) noexcept { return it += n; }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) noexcept { return it -= n; }
+        friend difference_type operator-(const basic_iterator &a, const basic_iterator &b) noexcept {
+            return static_cast<difference_type>(a.index_) - static_cast<difference_type>(b.index_);
+        }
+        friend bool operator==(const basic_iterator &a, const basic_iterator &b) noexcept { return a.index_ == b.index_; }
+        friend bool operator!=(const basic_iterator &a, const basic_iterator &b) noexcept { return a.index_ != b.index_; }
+        friend bool operator<(const basic_iterator &a, const basic_iterator &b) noexcept { return a.index_ < b.index_; }
+        friend bool operator>(const basic_iterator &a, const basic_iterator &b) noexcept { return a.index_ > b.index_; }
+        friend bool operator<=(const basic_iterator &a, const basic_iterator &b) noexcept { return a.index_ <= b.index_; }
+        friend bool operator>=(const basic_iterator &a, const basic_iterator &b) noexcept { return a.index_ >= b.index_; }
+
+        /* Zero referenced entry index, oldest entry first */
+        std::size_t index() const noexcept { return index_; }
+
+    private:
+        ring_pointer ring_ = nullptr;
+        std::size_t index_ = 0;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    /* Result of an fpos lookup: the entry holding it and the byte offset within */
+    struct position {
+        const_iterator entry;
+        std::size_t offset;
+    };
+
+    ring() noexcept = default;
+    ring(const ring &) = delete;
+    ring &operator=(const ring &) = delete;
+    ~ring() { clear(); }
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+    std::size_t size() const noexcept { return count_; }
+    bool empty() const noexcept { return count_ == 0; }
+    bool full() const noexcept { return count_ == Capacity; }
+    /* Total bytes of all entries, kept up to date by push() like calculate_size() */
+    std::size_t bytes() const noexcept { return total_; }
+
+    iterator begin() noexcept { return iterator(this, 0); }
+    iterator end() noexcept { return iterator(this, count_); }
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    const_iterator end() const noexcept { return const_iterator(this, count_); }
+
+    /**
+     * Adds @param e as the newest entry.
+     * @return the oldest entry when it had to make room, so the caller decides when to release it
+     */
+    std::optional<Entry> push(Entry e) noexcept {
+        std::optional<Entry> evicted;
+
+        if(full()){
+            pop_oldest(&evicted);
+        }
+        std::size_t slot = (out_ + count_) & mask;
+        ::new (static_cast<void *>(&slots_[slot])) Entry(std::move(e));
+        cumulative_[slot] = running_;
+        running_ += at_slot(slot).size();
+        total_ += at_slot(slot).size();
+        count_++;
+        return evicted;
+    }
+
+    /**
+     * Constructs the newest entry in place from @param args, see push()
+     */
+    template <typename... Args>
+    std::optional<Entry> emplace(Args &&...args) {
+        return push(Entry(std::forward<Args>(args)...));
+    }
+
+    /**
+     * Destroys every entry
+     */
+    void clear() noexcept {
+        while(!empty()){
+            pop_oldest();
+        }
+    }
+
+    /**
+     * Binary search for the entry holding byte @param fpos of the concatenated entries.
+     * @return the entry and offset within it, or nullopt when fpos is past the stored bytes
+     */
+    std::optional<position> locate(std::size_t fpos) const noexcept {
+        if(fpos >= total_){
+            return std::nullopt;
+        }
+
+        // Last entry starting at or before fpos, zero sized entries are never selected
+        std::size_t base = cumulative_[out_ & mask];
+        std::size_t low = 0, high = count_ - 1;
+        while(low < high){
+            std::size_t mid = low + ((high - low + 1) / 2);
+            if(cumulative_[(out_ + mid) & mask] - base <= fpos){
+                low = mid;
+            }else{
+                high = mid - 1;
+            }
+        }
+        return position{const_iterator(this, low), fpos - (cumulative_[(out_ + low) & mask] - base)};
+    }
+
+    /**
+     * @return the bytes of the entry holding @param fpos from fpos to the end of that entry,
+     * empty when fpos is past the stored bytes
+     */
+    std::string_view find(std::size_t fpos) const noexcept {
+        auto pos = locate(fpos);
+        if(!pos){
+            return {};
+        }
+        return std::string_view(pos->entry->data() + pos->offset, pos->entry->size() - pos->offset);
+    }
+
+    /**
+     * Translates entry @param index (oldest first) and @param offset within it into an fpos,
+     * with the bounds checks of AESDCHAR_IOCSEEKTO
+     */
+    std::optional<std::size_t> fpos_for_entry(std::size_t index, std::size_t offset) const noexcept {
+        if( (index >= count_) || (offset >= at_slot(out_ + index).size()) ){
+            return std::nullopt;
+        }
+        return (cumulative_[(out_ + index) & mask] - cumulative_[out_ & mask]) + offset;
+    }
+
+private:
+    Entry &at_slot(std::size_t slot) noexcept {
+        return *std::launder(reinterpret_cast<Entry *>(&slots_[slot & mask]));
+    }
+    const Entry &at_slot(std::size_t slot) const noexcept {
+        return *std::launder(reinterpret_cast<const Entry *>(&slots_[slot & mask]));
+    }
+
+    /* Removes the oldest entry, moving it to @param evicted if given */
+    void pop_oldest(std::optional<Entry> *evicted = nullptr) noexcept {
+        total_ -= at_slot(out_).size();
+        if(evicted != nullptr){
+            evicted->emplace(std::move(at_slot(out_)));
+        }
+        at_slot(out_).~Entry();
+        out_ = (out_ + 1) & mask;
+        count_--;
+    }
+
+    /* Raw storage so Entry needs no default constructor, slots hold live entries only while in the ring */
+    std::aligned_storage_t<sizeof(Entry), alignof(Entry)> slots_[Capacity];
+    /* Running byte count when each entry was added, wraps like the C buffer's cumulative_offs */
+    std::size_t cumulative_[Capacity] = {};
+    std::size_t out_ = 0;
+    std::size_t count_ = 0;
+    std::size_t total_ = 0;
+    std::size_t running_ = 0;
+};
+
+} // namespace aesd
+
+#endif /* AESD_RING_HPP */
@@ -33,14 +33,133 @@ struct aesd_seekto {
     uint32_t write_cmd_offset;
 };
 
+/**
+ * Passed with AESDCHAR_IOCSEEKSEQ and AESDCHAR_IOCSEEKTIME to seek to the first write command
+ * at or after a sequence number or a point in time.  The driver overwrites both fields with
+ * those of the write command found.
+ */
+struct aesd_seekwhen {
+    /**
+     * Sequence number of the write command, counting every write since the module was loaded
+     */
+    uint64_t seq;
+    /**
+     * Time the write command was stored, in ns since the epoch (CLOCK_REALTIME)
+     */
+    uint64_t timestamp;
+};
+
+/**
+ * One write command as described by AESDCHAR_IOCMETADATA
+ */
+struct aesd_entry_meta {
+    /**
+     * File position of the first byte, where AESDCHAR_IOCSEEKTO to this command with offset 0 moves
+     */
+    uint64_t offset;
+    uint64_t size;
+    /**
+     * As reported by AESDCHAR_IOCSEEKSEQ and AESDCHAR_IOCSEEKTIME
+     */
+    uint64_t seq;
+    uint64_t timestamp;
+};
+
+/**
+ * Passed with AESDCHAR_IOCMETADATA to describe the stored write commands in one call.  The table and
+ * the totals are one consistent snapshot; at most AESD_METADATA_MAX_ENTRIES commands are described per
+ * call, larger histories are paged through with first_entry while generation stays the same.
+ */
+struct aesd_metadata {
+    /**
+     * In: zero referenced index of the first write command to describe, oldest first
+     */
+    uint32_t first_entry;
+    /**
+     * In: struct aesd_entry_meta the table holds.  Out: how many were filled
+     */
+    uint32_t max_entries;
+    /**
+     * In: user address of the struct aesd_entry_meta table
+     */
+    uint64_t entries;
+    /**
+     * Out: write commands and bytes stored in the device
+     */
+    uint32_t nr_entries;
+    uint32_t reserved;
+    uint64_t total_size;
+    /**
+     * Out: changes whenever a write command is stored or evicted, equal generations mean the same
+     * commands at the same offsets
+     */
+    uint64_t generation;
+};
+
+#define AESD_METADATA_MAX_ENTRIES 4096
+
+/**
+ * First page of an mmap of the aesdchar device, loaded with aesd_mmap_bytes set.  The data area
+ * follows it twice in a row, so stored bytes wrapping its end read contiguously:
+ *
+ *   offset 0                     struct aesd_mmap_header (one page)
+ *   offset PAGE_SIZE             data area, data_size bytes
+ *   offset PAGE_SIZE + data_size the same data area again
+ *
+ * Stored bytes are the write commands back to back, oldest first, starting at data area offset
+ * (head - size) & (data_size - 1).  The mapping is read-only and changes under the reader:
+ * read generation, skip if odd, scan, then read generation again (with read barriers in between)
+ * and retry if it changed.
+ */
+struct aesd_mmap_header {
+    /**
+     * AESD_MMAP_MAGIC and AESD_MMAP_VERSION
+     */
+    uint32_t magic;
+    uint32_t version;
+    /**
+     * Incremented before and after every update, odd while the driver changes the mapping
+     */
+    uint64_t generation;
+    /**
+     * Bytes in the data area, a power of two multiple of the page size
+     */
+    uint64_t data_size;
+    /**
+     * Running count of bytes ever stored, the newest byte is at (head - 1) & (data_size - 1)
+     */
+    uint64_t head;
+    /**
+     * Bytes and write commands currently stored
+     */
+    uint64_t size;
+    uint64_t nr_entries;
+};
+
+#define AESD_MMAP_MAGIC 0x41455344 /* "AESD" */
+#define AESD_MMAP_VERSION 1
+
 // Pick an arbitrary unused value from https://github.com/torvalds/linux/blob/master/Documentation/userspace-api/ioctl/ioctl-number.rst
 #define AESD_IOC_MAGIC 0x16
 
 // Define a write command from the user point of view, use command number 1
 #define AESDCHAR_IOCSEEKTO _IOWR(AESD_IOC_MAGIC, 1, struct aesd_seekto)
+// Seek to the first write command at or after aesd_seekwhen.seq
+#define AESDCHAR_IOCSEEKSEQ _IOWR(AESD_IOC_MAGIC, 2, struct aesd_seekwhen)
+// Seek to the first write command stored at or after aesd_seekwhen.timestamp
+#define AESDCHAR_IOCSEEKTIME _IOWR(AESD_IOC_MAGIC, 3, struct aesd_seekwhen)
+/*
+ * Non-zero turns on follow mode for this open file, like tail -f: reads continue from the current
+ * position by write command sequence number, so commands evicted meanwhile are skipped rather than
+ * shifting the position, and wait for the next write command at the end unless O_NONBLOCK is set.
+ * Zero turns it off again, reads at the end then return 0.
+ */
+#define AESDCHAR_IOCFOLLOW _IOW(AESD_IOC_MAGIC, 4, uint32_t)
+// Describe the stored write commands, see struct aesd_metadata
+#define AESDCHAR_IOCMETADATA _IOWR(AESD_IOC_MAGIC, 5, struct aesd_metadata)
 /**
  * The maximum number of commands supported, used for bounds checking
  */
-#define AESDCHAR_IOC_MAXNR 1
+#define AESDCHAR_IOC_MAXNR 5
 
 #endif /* AESD_IOCTL_H */
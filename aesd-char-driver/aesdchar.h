@@ -8,7 +8,7 @@
 #ifndef AESD_CHAR_DRIVER_AESDCHAR_H_
 #define AESD_CHAR_DRIVER_AESDCHAR_H_
 
-#define AESD_DEBUG 1  //Remove comment on this line to enable debug
+/* AESD_DEBUG is defined by the Makefile when built with DEBUG = y */
 
 #undef PDEBUG             /* undef it, just in case */
 #ifdef AESD_DEBUG
@@ -26,14 +26,77 @@
 
 #include "aesd-circular-buffer.h"
 #include "aesd_ioctl.h"
+#include <linux/list.h>
 #include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/seqlock.h>
+#include <linux/srcu.h>
+
+/* Page sized piece of a write command arriving over several writes, appended to after the working entry */
+struct aesd_chunk{
+    struct list_head list;
+    size_t used; // Bytes of data filled so far
+    char data[];
+};
+
+/*
+ * Payload of a write command stored in the circular buffer, entries point at data.  Readers copy payloads
+ * without the mutex, so an evicted one is freed only after an SRCU grace period.
+ */
+struct aesd_payload{
+    struct rcu_head rcu;
+    size_t size; // Bytes allocated, header included, which also picks the allocator to free with
+    char data[];
+};
+
+/* Data bytes held by one struct aesd_chunk */
+#define AESD_CHUNK_DATA (PAGE_SIZE - offsetof(struct aesd_chunk, data))
+
+/* Log2 nanosecond buckets of the latency histograms, bucket i counts [2^i, 2^(i+1)), the last one anything slower */
+#define AESD_HIST_BUCKETS 32
+
+/* Per CPU statistics of one device, all u64 so the debugfs file sums them as an array */
+struct aesd_stats{
+    u64 reads;
+    u64 read_bytes;
+    u64 writes;
+    u64 write_bytes;
+    u64 commits;
+    u64 evictions;
+    u64 seeks;
+    u64 ioctls;
+    u64 read_ns[AESD_HIST_BUCKETS]; // read_iter latency, without follow mode waits
+    u64 write_ns[AESD_HIST_BUCKETS]; // write_iter latency
+    u64 lock_wait_ns[AESD_HIST_BUCKETS]; // Waits for the device mutex
+};
 
 struct aesd_dev{
     struct aesd_circular_buffer buffer; // Circular buffer structure
-    struct aesd_buffer_entry entry; // entry to buffer data before placing it into circular buffer
-    struct mutex mutex; // Locking mechanism to prevent race conditions
+    struct aesd_buffer_entry entry; // entry to buffer data before placing it into circular buffer, holds the first write
+    struct list_head chunks; // struct aesd_chunk list with the later writes of an unfinished command
+    size_t chunks_size; // Bytes held in chunks
+    /* Page backed entry storage for mmap, all NULL/0 without aesd_mmap_bytes */
+    struct page **pages; // Header page followed by the data pages twice, as mapped by aesd_mmap
+    unsigned long nr_data_pages;
+    struct aesd_mmap_header *header; // Mapped header, updated under mutex
+    char *data; // Data pages mapped twice in a row, so entries wrapping the end stay contiguous
+    uint64_t data_head; // Running count of bytes stored in data
+    struct aesd_buffer_entry *history; // entry storage allocated for aesd_history, NULL for the default
+    struct mutex mutex; // Serializes writers, readers go without it
+    seqcount_mutex_t seq; // Bumped by writers around buffer changes, readers retry samples of the buffer taken across one
+    uint64_t generation; // Count of buffer changes, reported by AESDCHAR_IOCMETADATA
+    struct srcu_struct srcu; // Readers copy payloads inside its read section, evicted payloads wait for a grace period
+    wait_queue_head_t wait; // Readers in follow mode and pollers waiting for the next write command
+    struct aesd_stats __percpu *stats; // Shown in debugfs, aesdchar/aesdcharN/stats
     struct cdev cdev;     /* Char device structure      */
 };
 
+/* Per open file state, kept in filp->private_data, like f_pos not serialized between users of one open file */
+struct aesd_file{
+    struct aesd_dev *dev;
+    bool follow; // Set with AESDCHAR_IOCFOLLOW, reads go by sequence number and wait for new write commands
+    uint64_t seq; // Follow mode: write command read next and the offset within it
+    size_t offset;
+};
 
 #endif /* AESD_CHAR_DRIVER_AESDCHAR_H_ */
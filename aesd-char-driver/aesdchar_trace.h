@@ -0,0 +1,147 @@
+/*
+ * aesdchar_trace.h
+ *
+ *  @brief Tracepoints of the aesdchar driver, under events/aesdchar in tracefs
+ *
+ *  Disabled tracepoints cost a patched out branch.  Enable them with
+ *  echo 1 > /sys/kernel/tracing/events/aesdchar/enable or perf record -e 'aesdchar:*'.
+ *  main.c defines CREATE_TRACE_POINTS before including this file.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM aesdchar
+
+#if !defined(_AESDCHAR_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _AESDCHAR_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(aesd_open,
+    TP_PROTO(unsigned int minor, unsigned int flags),
+    TP_ARGS(minor, flags),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(unsigned int, flags)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->flags = flags;
+    ),
+    TP_printk("minor=%u flags=0x%x", __entry->minor, __entry->flags)
+);
+
+/* read_iter and write_iter: position and size asked for, result and time spent waiting for the mutex */
+DECLARE_EVENT_CLASS(aesd_rw,
+    TP_PROTO(unsigned int minor, loff_t pos, size_t count, ssize_t ret, u64 lock_wait_ns),
+    TP_ARGS(minor, pos, count, ret, lock_wait_ns),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(loff_t, pos)
+        __field(size_t, count)
+        __field(ssize_t, ret)
+        __field(u64, lock_wait_ns)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->pos = pos;
+        __entry->count = count;
+        __entry->ret = ret;
+        __entry->lock_wait_ns = lock_wait_ns;
+    ),
+    TP_printk("minor=%u pos=%lld count=%zu ret=%zd lock_wait_ns=%llu", __entry->minor, __entry->pos,
+            __entry->count, __entry->ret, __entry->lock_wait_ns)
+);
+
+DEFINE_EVENT(aesd_rw, aesd_read,
+    TP_PROTO(unsigned int minor, loff_t pos, size_t count, ssize_t ret, u64 lock_wait_ns),
+    TP_ARGS(minor, pos, count, ret, lock_wait_ns)
+);
+
+DEFINE_EVENT(aesd_rw, aesd_write,
+    TP_PROTO(unsigned int minor, loff_t pos, size_t count, ssize_t ret, u64 lock_wait_ns),
+    TP_ARGS(minor, pos, count, ret, lock_wait_ns)
+);
+
+/* A complete write command stored, with the number of older ones it evicted */
+TRACE_EVENT(aesd_commit,
+    TP_PROTO(unsigned int minor, u64 seq, size_t size, size_t nr_evicted),
+    TP_ARGS(minor, seq, size, nr_evicted),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(u64, seq)
+        __field(size_t, size)
+        __field(size_t, nr_evicted)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->seq = seq;
+        __entry->size = size;
+        __entry->nr_evicted = nr_evicted;
+    ),
+    TP_printk("minor=%u seq=%llu size=%zu nr_evicted=%zu", __entry->minor, __entry->seq, __entry->size,
+            __entry->nr_evicted)
+);
+
+/* A write command dropped by the history limits or, with shrinker set, under memory pressure */
+TRACE_EVENT(aesd_evict,
+    TP_PROTO(unsigned int minor, u64 seq, size_t size, bool shrinker),
+    TP_ARGS(minor, seq, size, shrinker),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(u64, seq)
+        __field(size_t, size)
+        __field(bool, shrinker)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->seq = seq;
+        __entry->size = size;
+        __entry->shrinker = shrinker;
+    ),
+    TP_printk("minor=%u seq=%llu size=%zu shrinker=%d", __entry->minor, __entry->seq, __entry->size,
+            __entry->shrinker)
+);
+
+TRACE_EVENT(aesd_seek,
+    TP_PROTO(unsigned int minor, loff_t offset, int whence, loff_t ret),
+    TP_ARGS(minor, offset, whence, ret),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(loff_t, offset)
+        __field(int, whence)
+        __field(loff_t, ret)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->offset = offset;
+        __entry->whence = whence;
+        __entry->ret = ret;
+    ),
+    TP_printk("minor=%u offset=%lld whence=%d ret=%lld", __entry->minor, __entry->offset, __entry->whence,
+            __entry->ret)
+);
+
+TRACE_EVENT(aesd_ioctl,
+    TP_PROTO(unsigned int minor, unsigned int cmd, long ret),
+    TP_ARGS(minor, cmd, ret),
+    TP_STRUCT__entry(
+        __field(unsigned int, minor)
+        __field(unsigned int, cmd)
+        __field(long, ret)
+    ),
+    TP_fast_assign(
+        __entry->minor = minor;
+        __entry->cmd = cmd;
+        __entry->ret = ret;
+    ),
+    TP_printk("minor=%u cmd=0x%x ret=%ld", __entry->minor, __entry->cmd, __entry->ret)
+);
+
+#endif /* _AESDCHAR_TRACE_H */
+
+/* Out of tree: the Makefile adds the module directory to main.o's include path */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE aesdchar_trace
+#include <trace/define_trace.h>
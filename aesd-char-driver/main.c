@@ -12,157 +12,753 @@
  */
 
 #include <linux/module.h>
+#include <linux/version.h> // LINUX_VERSION_CODE, for APIs that changed since the 5.15 target
 #include <linux/init.h>
 #include <linux/printk.h>
 #include <linux/types.h>
 #include <linux/cdev.h>
 #include <linux/fs.h> // file_operations
+#include <linux/uio.h> // iov_iter
+#include <linux/slab.h>
+#include <linux/mm.h> // kvcalloc, vm_map_pages
+#include <linux/vmalloc.h> // vmap
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
+#include <linux/poll.h>
+#include <linux/overflow.h> // struct_size
+#include <linux/seqlock.h>
+#include <linux/srcu.h>
+#include <linux/atomic.h>
+#include <linux/shrinker.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "aesdchar.h"
 
+#define CREATE_TRACE_POINTS
+#include "aesdchar_trace.h"
+
 int aesd_major =   0; // use dynamic major
 int aesd_minor =   0;
+/* Write commands kept by the device, a power of two; 0 keeps the default AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED */
+unsigned int aesd_history = 0;
+/* Byte budget for all stored write commands, oldest ones are evicted to respect it; 0 for no limit */
+unsigned long aesd_max_bytes = 0;
+/*
+ * Page backed storage for write commands that userspace can mmap read-only, a power of two multiple of
+ * PAGE_SIZE and an upper bound for the byte budget; 0 keeps kmalloc'd commands and disables mmap
+ */
+unsigned long aesd_mmap_bytes = 0;
+
+/* Number of devices, /dev/aesdchar0..N-1, each with its own ring and mutex */
+int aesd_nr_devs = 1;
+
+module_param(aesd_nr_devs, int, S_IRUGO);
+module_param(aesd_history, uint, S_IRUGO);
+module_param(aesd_max_bytes, ulong, S_IRUGO);
+module_param(aesd_mmap_bytes, ulong, S_IRUGO);
+
+/* Evicted entries collected under the device mutex per round, retired after unlocking it */
+#define AESD_EVICT_BATCH 8
+/* Entry pieces described per aesd_circular_buffer_fill_iovec() round of a read */
+#define AESD_READ_BATCH 16
+/* Upper bound for aesd_nr_devs */
+#define AESD_MAX_DEVS 256
+/* Payloads up to this size, header included, come from aesd_payload_cache, larger ones from kvmalloc */
+#define AESD_PAYLOAD_SLAB_SIZE 256
 
 MODULE_AUTHOR("Alan Cano");
 MODULE_LICENSE("Dual BSD/GPL");
 
-struct aesd_dev aesd_device;
+struct aesd_dev *aesd_devices; // Allocated in aesd_init_module, aesd_nr_devs of them
+
+static struct kmem_cache *aesd_payload_cache; // Small payloads, most write commands are short lines
+static struct shrinker *aesd_shrinker; // Evicts the oldest entries under memory pressure, NULL if unregistered
+static struct dentry *aesd_debugfs; // aesdchar directory in debugfs, memory and per device statistics
+
+/* Bytes of payloads and chunks held by all devices, and the most ever held, read-only parameters */
+static atomic_long_t aesd_mem_held = ATOMIC_LONG_INIT(0);
+static atomic_long_t aesd_mem_peak = ATOMIC_LONG_INIT(0);
+
+static int aesd_get_mem(char *buffer, const struct kernel_param *kp){
+    return sysfs_emit(buffer, "%ld\n", atomic_long_read((atomic_long_t *)kp->arg));
+}
+
+static const struct kernel_param_ops aesd_mem_ops = {
+    .get = aesd_get_mem,
+};
+
+module_param_cb(aesd_mem_held, &aesd_mem_ops, &aesd_mem_held, S_IRUGO);
+module_param_cb(aesd_mem_peak, &aesd_mem_ops, &aesd_mem_peak, S_IRUGO);
+
+static void aesd_mem_account(long bytes){
+    long held = atomic_long_add_return(bytes, &aesd_mem_held);
+    long peak = atomic_long_read(&aesd_mem_peak);
+
+    while( (held > peak) && !atomic_long_try_cmpxchg(&aesd_mem_peak, &peak, held) ){
+    }
+}
 
 static int aesd_open(struct inode *inode, struct file *filp){
-    PDEBUG("open");
+    struct aesd_file *file; // Per open state
 
-    struct aesd_dev *dev; // Device information
+    PDEBUG("open");
+    file = kzalloc(sizeof(struct aesd_file), GFP_KERNEL);
+    if(file == NULL){
+        return -ENOMEM;
+    }
     // Takes a pointer (inode->i_cdev) to cdev field inside structure aesd_dev
-    dev = container_of(inode->i_cdev, struct aesd_dev, cdev); 
-    filp->private_data = dev; // Store pointer in the private_data of the file pointer
+    file->dev = container_of(inode->i_cdev, struct aesd_dev, cdev);
+    filp->private_data = file; // Store pointer in the private_data of the file pointer
+    filp->f_mode |= FMODE_NOWAIT; // read_iter/write_iter honour IOCB_NOWAIT, allow RWF_NOWAIT and io_uring nowait
+    trace_aesd_open(MINOR(inode->i_rdev), filp->f_flags);
     return 0;
 }
 
 static int aesd_release(struct inode *inode, struct file *filp){
     PDEBUG("release");
-    /*No need to deallocate anything here, everything to be handles at cleaup function*/
+    /* Only the per open state, device data is handled at cleanup function */
+    kfree(filp->private_data);
     return 0;
 }
 
-static ssize_t aesd_read(struct file *filp, char __user *buf, size_t count, loff_t *f_pos){
-    PDEBUG("read %zu bytes with offset %lld",count,*f_pos);
+/* Get to aesd_dev using the per open state saved in open function */
+static struct aesd_dev *aesd_dev_of(struct file *filp){
+    return ((struct aesd_file *)filp->private_data)->dev;
+}
 
-    ssize_t retval = 0;
-    size_t entry_offset, entry_remaining_bytes, bytes_to_read;
-    struct aesd_buffer_entry *entry; // Define variable to hold information out of circular buffer
+static unsigned int aesd_minor_of(struct aesd_dev *dev){
+    return MINOR(dev->cdev.dev);
+}
 
-    /* Get to aesd_dev using filp->private_data saved in open function */
-    struct aesd_dev *dev = filp->private_data;
+/* Latency histogram bucket of ns, see AESD_HIST_BUCKETS */
+static unsigned int aesd_hist_bucket(u64 ns){
+    return min_t(unsigned int, ilog2(ns | 1), AESD_HIST_BUCKETS - 1);
+}
 
-    /* Lock while reading */
-    if (mutex_lock_interruptible(&dev->mutex)){
-        /* 
+/*
+ * Lock the device for a write or a page backed read, without sleeping for RWF_NOWAIT/IOCB_NOWAIT callers.
+ * The time spent getting the mutex goes to *wait_ns and the lock wait histogram.
+ */
+static int aesd_lock_iocb(struct aesd_dev *dev, struct kiocb *iocb, u64 *wait_ns){
+    u64 start = ktime_get_ns();
+    int retval;
+
+    if(iocb->ki_flags & IOCB_NOWAIT){
+        retval = mutex_trylock(&dev->mutex) ? 0 : -EAGAIN;
+    }else{
+        /*
             Kernel will either restart the call or return error to the user.
             Should undo any user-visible changes that might have been made.
         */
-        PDEBUG("Mutex lock failed");
-        return -ERESTARTSYS; 
+        retval = mutex_lock_interruptible(&dev->mutex) ? -ERESTARTSYS : 0;
+    }
+    *wait_ns = ktime_get_ns() - start;
+    this_cpu_inc(dev->stats->lock_wait_ns[aesd_hist_bucket(*wait_ns)]);
+    return retval;
+}
+
+/*
+ * Payloads of write commands.  Readers sample entries under dev->seq without the mutex and copy from them
+ * inside an SRCU read section, so payloads must outlive their eviction by a grace period.
+ */
+static char *aesd_payload_alloc(size_t size){
+    struct aesd_payload *payload;
+    size_t bytes = struct_size(payload, data, size);
+
+    if(bytes <= AESD_PAYLOAD_SLAB_SIZE){
+        payload = kmem_cache_alloc(aesd_payload_cache, GFP_KERNEL);
+    }else{
+        /* vmalloc when fragmented memory has no contiguous run left for a large command */
+        payload = kvmalloc(bytes, GFP_KERNEL);
+    }
+    if(payload == NULL){
+        return NULL;
+    }
+    payload->size = bytes;
+    aesd_mem_account(bytes);
+    return payload->data;
+}
+
+static void aesd_payload_destroy(struct aesd_payload *payload){
+    aesd_mem_account(-(long)payload->size);
+    if(payload->size <= AESD_PAYLOAD_SLAB_SIZE){
+        kmem_cache_free(aesd_payload_cache, payload);
+    }else{
+        kvfree(payload);
     }
+}
+
+static struct aesd_payload *aesd_payload_of(const char *data){
+    return (struct aesd_payload *)(data - offsetof(struct aesd_payload, data));
+}
+
+/* Free a payload no reader can see: never stored, or left in a device being torn down */
+static void aesd_payload_free(const char *data){
+    if(data != NULL){
+        aesd_payload_destroy(aesd_payload_of(data));
+    }
+}
+
+static void aesd_payload_free_rcu(struct rcu_head *rcu){
+    aesd_payload_destroy(container_of(rcu, struct aesd_payload, rcu));
+}
+
+/*
+ * Free the payload of an evicted entry once readers that may have sampled it leave their read sections.
+ * shrinker tells memory pressure from the history limits apart in the trace.
+ */
+static void aesd_payload_retire(struct aesd_dev *dev, const struct aesd_buffer_entry *entry, bool shrinker){
+    trace_aesd_evict(aesd_minor_of(dev), entry->seq, entry->size, shrinker);
+    this_cpu_inc(dev->stats->evictions);
+    call_srcu(&dev->srcu, &aesd_payload_of(entry->buffptr)->rcu, aesd_payload_free_rcu);
+}
 
-    PDEBUG("Data locked with mutex, reading operation");
-    
-    /* Find entry that matches byte offset position or return NULL if none was found */
-    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&dev->buffer, *f_pos, &entry_offset);
-    /* Verify if there's an existing entry in that position, otherwise return 0 */
+/* Bracket changes to the circular buffer, mutex held: readers retry samples taken across one */
+static void aesd_buffer_begin(struct aesd_dev *dev){
+    write_seqcount_begin(&dev->seq);
+}
+
+static void aesd_buffer_end(struct aesd_dev *dev){
+    dev->generation++;
+    write_seqcount_end(&dev->seq);
+}
+
+/* Cursor of the write command holding fpos, or of the next one past the end, inside a dev->seq sample */
+static void aesd_fpos_cursor(struct aesd_dev *dev, loff_t pos, uint64_t *cursor, size_t *entry_offset){
+    struct aesd_buffer_entry *entry;
+
+    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&dev->buffer, pos, entry_offset);
     if(entry != NULL){
-        /* Figure out how many bytes are left to read of the entry after offset */
-        entry_remaining_bytes = (entry->size - entry_offset);
-        /* Verifiy if count is less or equal than entry remaining-bytes, if so will read count */
-        if(entry_remaining_bytes >= count ){ 
-            bytes_to_read = count;
-        }else{ // Otherwise, will read only entry remaining-bytes of the entry
-            bytes_to_read = entry_remaining_bytes;
-        }
-
-        /* Starting at offset position of the entry, will send remaining bytes of the entry to the user */
-        if( copy_to_user(buf, (entry->buffptr + entry_offset), bytes_to_read) ){
-            /* Will retrun -EFAULT if pointer is invalid or if invalid address is encountered during copy */
-            retval = -EFAULT;
-            goto exit;
+        *cursor = entry->seq;
+    }else{
+        *cursor = dev->buffer.next_seq;
+        *entry_offset = 0;
+    }
+}
+
+/*
+ * fpos of a cursor inside a dev->seq sample.  A cursor at the end of its write command moves on to the next
+ * one, and one whose write command was evicted moves to the oldest kept, at fpos 0.
+ */
+static loff_t aesd_cursor_fpos(struct aesd_dev *dev, uint64_t *cursor, size_t *entry_offset){
+    struct aesd_buffer_entry *entry;
+    size_t fpos;
+
+    entry = aesd_circular_buffer_find_entry_for_seq(&dev->buffer, *cursor, &fpos);
+    if(entry == NULL){
+        return aesd_circular_buffer_calculate_size(&dev->buffer);
+    }
+    if(entry->seq != *cursor){
+        *cursor = entry->seq;
+        *entry_offset = 0;
+    }else if(*entry_offset >= entry->size){
+        (*cursor)++;
+        *entry_offset = 0;
+        fpos += entry->size;
+    }else{
+        fpos += *entry_offset;
+    }
+    return fpos;
+}
+
+/*
+ * Copy from fpos *pos, or from the cursor in follow mode, on through as many entries as the user buffers hold.
+ * The start is turned into a (write command, offset) cursor in the same dev->seq sample as the first batch
+ * of entry pieces, and each later batch is sampled from the cursor the previous one left, so evictions
+ * meanwhile can't shift the bytes returned: they stay contiguous, and the read stops short if the cursor's
+ * write command itself is evicted.  Pieces are copied out inside the SRCU read section keeping their
+ * payloads alive, no mutex needed.  *pos ends up at the cursor, which follow mode keeps in the file.
+ * Returns the bytes copied, or -EFAULT when the first user address is invalid.
+ */
+static ssize_t aesd_copy_entries(struct aesd_dev *dev, struct aesd_file *file, loff_t *pos, struct iov_iter *to){
+    ssize_t retval = 0;
+    size_t nr_vec, bytes, copied, entry_offset = 0, first_offset, i;
+    uint64_t cursor = 0, first_seq;
+    unsigned int seq;
+    loff_t end_pos;
+    bool anchored = false;
+    int idx;
+    struct kvec vec[AESD_READ_BATCH]; // Entry pieces described by the circular buffer, copied out in batches
+
+    if(iov_iter_count(to) == 0){
+        return 0;
+    }
+
+    idx = srcu_read_lock(&dev->srcu);
+    while(iov_iter_count(to) > 0){
+        do{
+            seq = read_seqcount_begin(&dev->seq);
+            first_seq = cursor;
+            first_offset = entry_offset;
+            if(!anchored && file->follow){
+                /* Catch up with the oldest write command kept if the cursor's was evicted */
+                first_seq = file->seq;
+                first_offset = file->offset;
+                aesd_cursor_fpos(dev, &first_seq, &first_offset);
+            }else if(!anchored){
+                aesd_fpos_cursor(dev, *pos, &first_seq, &first_offset);
+            }
+            nr_vec = aesd_circular_buffer_fill_iovec_seq(&dev->buffer, &first_seq, &first_offset,
+                    iov_iter_count(to), vec, AESD_READ_BATCH, &bytes);
+        }while(read_seqcount_retry(&dev->seq, seq));
+        cursor = first_seq;
+        entry_offset = first_offset;
+        anchored = true;
+        if(nr_vec == 0){
+            break;
+        }
+        for(i = 0; i < nr_vec; i++){
+            copied = copy_to_iter(vec[i].iov_base, vec[i].iov_len, to);
+            retval += copied;
+            cursor = first_seq + i;
+            entry_offset = (i == 0 ? first_offset : 0) + copied;
+            if(copied != vec[i].iov_len){
+                /* Invalid user address, report the bytes copied before it or -EFAULT if none were */
+                retval = retval ? retval : -EFAULT;
+                goto out;
+            }
         }
-        
-        /* Update offset to new position after reading */
-        *f_pos += bytes_to_read;
-        /* Return how many bytes were read */
-        retval = bytes_to_read;
     }
-    
-    exit:
-    /* Unlock data */
-    mutex_unlock(&dev->mutex);
+
+    out:
+    srcu_read_unlock(&dev->srcu, idx);
+
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        first_seq = cursor;
+        first_offset = entry_offset;
+        end_pos = aesd_cursor_fpos(dev, &first_seq, &first_offset);
+    }while(read_seqcount_retry(&dev->seq, seq));
+    if(file->follow){
+        file->seq = first_seq;
+        file->offset = first_offset;
+        *pos = end_pos;
+    }else if(retval > 0){
+        *pos = end_pos;
+    }
     return retval;
 }
 
-static ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos){
-    ssize_t retval = -ENOMEM;
-    PDEBUG("write %zu bytes with offset %lld",count,*f_pos);
+/* Sequence number of the next write command, sampled without the mutex */
+static uint64_t aesd_next_seq(struct aesd_dev *dev){
+    unsigned int seq;
+    uint64_t next_seq;
 
-    /* Get to aesd_dev using filp->private_data saved in open function */
-    struct aesd_dev *dev = filp->private_data;
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        next_seq = dev->buffer.next_seq;
+    }while(read_seqcount_retry(&dev->seq, seq));
+    return next_seq;
+}
 
-    /* Lock when writting */
-    if(mutex_lock_interruptible(&dev->mutex)){
+/* Set the follow mode cursor to the write command holding fpos, or to the next one past the end */
+static void aesd_follow_fpos(struct aesd_dev *dev, struct aesd_file *file, loff_t pos){
+    size_t entry_offset;
+    unsigned int seq;
+    uint64_t cursor;
+
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        aesd_fpos_cursor(dev, pos, &cursor, &entry_offset);
+    }while(read_seqcount_retry(&dev->seq, seq));
+    file->seq = cursor;
+    file->offset = entry_offset;
+}
+
+/* Wait until a write command past the follow mode cursor is stored */
+static int aesd_follow_wait(struct aesd_dev *dev, struct aesd_file *file, struct kiocb *iocb){
+    if(file->seq < aesd_next_seq(dev)){
+        return 0;
+    }
+    if( (iocb->ki_filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT) ){
+        return -EAGAIN;
+    }
+    if(wait_event_interruptible(dev->wait, file->seq < aesd_next_seq(dev))){
         return -ERESTARTSYS;
     }
+    return 0;
+}
 
-    /* Calculate old and new size of buffptr */
-    size_t current_size, new_size;
-    current_size = dev->entry.size;
-    new_size = current_size + count;
+/*
+ * Serves read, readv and preadv: copies from the entry holding the file position on through as many
+ * entries as the user buffers hold, in one pass instead of one call per entry.  Readers don't take the
+ * mutex, except on page backed storage whose bytes are overwritten in place once evicted.
+ * In follow mode the position is the cursor's write command, and reads at the end wait for the next one.
+ */
+static ssize_t aesd_read_iter(struct kiocb *iocb, struct iov_iter *to){
+    ssize_t retval = 0;
+    loff_t pos = iocb->ki_pos, start_pos = iocb->ki_pos;
+    size_t count = iov_iter_count(to);
+    u64 start, lock_wait = 0;
+    bool locked;
+
+    /* Get to aesd_dev using filp->private_data saved in open function */
+    struct aesd_file *file = iocb->ki_filp->private_data;
+    struct aesd_dev *dev = file->dev;
 
-    /* Resize memory space needed for the entry string */
-    char *tmp = krealloc(dev->entry.buffptr, new_size, GFP_KERNEL); // Use tmp pointer to avoid losing data if krealloc fails
-    if(tmp == NULL){
-        /* Out of memory failure if no memory allocation failed */
-        retval = -ENOMEM;
-        goto exit;
+    PDEBUG("read %zu bytes with offset %lld", count, pos);
+
+    if(pos < 0){
+        retval = -EINVAL;
+        goto out;
+    }
+    if(file->follow && (count > 0)){
+        retval = aesd_follow_wait(dev, file, iocb);
+        if(retval){
+            goto out;
+        }
     }
-    /* buffptr will now point to the new address of the reallocated memory when succesfull */
-    dev->entry.buffptr = tmp;
 
-    /* Copy string from user space and save in working entry at the last character written (current_size) */
-    if(copy_from_user((void *)(dev->entry.buffptr + current_size), buf, count)){
-        /* If copy fails, free memory of buffptr, point to NULL and set size as 0 */
-        kfree(dev->entry.buffptr);
-        dev->entry.buffptr = NULL;
-        dev->entry.size = 0;
-        retval = -EFAULT;
-        goto exit;
+    start = ktime_get_ns();
+    locked = (dev->header != NULL);
+    if(locked){
+        retval = aesd_lock_iocb(dev, iocb, &lock_wait);
+        if(retval){
+            PDEBUG("Mutex lock failed");
+            goto out;
+        }
+    }
+
+    retval = aesd_copy_entries(dev, file, &pos, to);
+
+    /* Update offset to new position after reading */
+    iocb->ki_pos = pos;
+    if(locked){
+        mutex_unlock(&dev->mutex);
+    }
+    this_cpu_inc(dev->stats->reads);
+    if(retval > 0){
+        this_cpu_add(dev->stats->read_bytes, retval);
+    }
+    this_cpu_inc(dev->stats->read_ns[aesd_hist_bucket(ktime_get_ns() - start)]);
+
+    out:
+    trace_aesd_read(aesd_minor_of(dev), start_pos, count, retval, lock_wait);
+    return retval;
+}
+
+/* Report readable once there are bytes past the file position, or past the cursor in follow mode */
+static __poll_t aesd_poll(struct file *filp, poll_table *wait){
+    struct aesd_file *file = filp->private_data;
+    struct aesd_dev *dev = file->dev;
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM;
+    unsigned int seq;
+    bool readable;
+
+    poll_wait(filp, &dev->wait, wait);
+
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        readable = file->follow ? (file->seq < dev->buffer.next_seq) :
+            (filp->f_pos < (loff_t)aesd_circular_buffer_calculate_size(&dev->buffer));
+    }while(read_seqcount_retry(&dev->seq, seq));
+    if(readable){
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    return mask;
+}
+
+/* Retire evicted payloads, taking the mutex again while more entries exceed the limits */
+static void aesd_release_evicted(struct aesd_dev *dev, struct aesd_buffer_entry *evicted, size_t nr_evicted){
+    size_t i;
+
+    while(nr_evicted > 0){
+        for(i = 0; i < nr_evicted; i++){
+            aesd_payload_retire(dev, &evicted[i], false);
+        }
+        if(nr_evicted < AESD_EVICT_BATCH){
+            break;
+        }
+        mutex_lock(&dev->mutex);
+        aesd_buffer_begin(dev);
+        nr_evicted = aesd_circular_buffer_evict(&dev->buffer, evicted, AESD_EVICT_BATCH);
+        aesd_buffer_end(dev);
+        mutex_unlock(&dev->mutex);
+    }
+}
+
+/* Page sized chunks, counted in aesd_mem_held like payloads */
+static struct aesd_chunk *aesd_chunk_alloc(void){
+    struct aesd_chunk *chunk = kmalloc(PAGE_SIZE, GFP_KERNEL);
+
+    if(chunk != NULL){
+        chunk->used = 0;
+        aesd_mem_account(PAGE_SIZE);
+    }
+    return chunk;
+}
+
+static void aesd_chunk_free(struct aesd_chunk *chunk){
+    aesd_mem_account(-(long)PAGE_SIZE);
+    kfree(chunk);
+}
+
+/* Free the unfinished command: working entry and chunks */
+static void aesd_discard_partial(struct aesd_dev *dev){
+    struct aesd_chunk *chunk, *next;
+
+    list_for_each_entry_safe(chunk, next, &dev->chunks, list){
+        list_del(&chunk->list);
+        aesd_chunk_free(chunk);
+    }
+    dev->chunks_size = 0;
+    aesd_payload_free(dev->entry.buffptr);
+    dev->entry.buffptr = NULL;
+    dev->entry.size = 0;
+}
+
+/*
+ * Append count bytes of an unfinished command to its chunks, filling the last chunk before adding pages.
+ * Chunks are allocated before anything is copied so -ENOMEM leaves the command as it was.
+ * Only the new bytes are searched, earlier ones held no newline or the command would be complete.
+ */
+static int aesd_append_chunks(struct aesd_dev *dev, struct iov_iter *from, size_t count, bool *newline){
+    struct aesd_chunk *chunk, *next, *start = NULL;
+    size_t spare = 0, piece;
+    LIST_HEAD(fresh);
+
+    if(!list_empty(&dev->chunks)){
+        start = list_last_entry(&dev->chunks, struct aesd_chunk, list);
+        spare = AESD_CHUNK_DATA - start->used;
+        if(spare == 0){
+            start = NULL;
+        }
     }
+    while(spare < count){
+        chunk = aesd_chunk_alloc();
+        if(chunk == NULL){
+            list_for_each_entry_safe(chunk, next, &fresh, list){
+                aesd_chunk_free(chunk);
+            }
+            return -ENOMEM;
+        }
+        list_add_tail(&chunk->list, &fresh);
+        spare += AESD_CHUNK_DATA;
+    }
+    if(start == NULL){
+        start = list_first_entry(&fresh, struct aesd_chunk, list);
+    }
+    list_splice_tail(&fresh, &dev->chunks);
+
+    /* From the first chunk with room on, fresh ones follow it */
+    *newline = false;
+    chunk = start;
+    list_for_each_entry_from(chunk, &dev->chunks, list){
+        if(count == 0){
+            break;
+        }
+        piece = min_t(size_t, count, AESD_CHUNK_DATA - chunk->used);
+        if(copy_from_iter(chunk->data + chunk->used, piece, from) != piece){
+            return -EFAULT;
+        }
+        if(memchr(chunk->data + chunk->used, '\n', piece)){
+            *newline = true;
+        }
+        chunk->used += piece;
+        dev->chunks_size += piece;
+        count -= piece;
+    }
+    return 0;
+}
+
+/*
+ * Join the working entry and its chunks into one buffer for the circular buffer, copying each byte once.
+ * A command that arrived in a single write has no chunks and is used as is.
+ */
+static int aesd_assemble_partial(struct aesd_dev *dev){
+    struct aesd_chunk *chunk, *next;
+    size_t size = dev->entry.size;
+    char *buf;
+
+    if(list_empty(&dev->chunks)){
+        return 0;
+    }
+    buf = aesd_payload_alloc(dev->entry.size + dev->chunks_size);
+    if(buf == NULL){
+        return -ENOMEM;
+    }
+    memcpy(buf, dev->entry.buffptr, dev->entry.size);
+    list_for_each_entry_safe(chunk, next, &dev->chunks, list){
+        memcpy(buf + size, chunk->data, chunk->used);
+        size += chunk->used;
+        list_del(&chunk->list);
+        aesd_chunk_free(chunk);
+    }
+    aesd_payload_free(dev->entry.buffptr);
+    dev->entry.buffptr = buf;
+    dev->entry.size = size;
+    dev->chunks_size = 0;
+    return 0;
+}
+
+/* Bracket changes to the mapped data area, readers retry while the generation is odd or changed */
+static void aesd_mmap_begin(struct aesd_dev *dev){
+    WRITE_ONCE(dev->header->generation, dev->header->generation + 1);
+    smp_wmb();
+}
+
+static void aesd_mmap_end(struct aesd_dev *dev){
+    dev->header->head = dev->data_head;
+    dev->header->size = aesd_circular_buffer_calculate_size(&dev->buffer);
+    dev->header->nr_entries = aesd_circular_buffer_entry_count(&dev->buffer);
+    smp_wmb();
+    WRITE_ONCE(dev->header->generation, dev->header->generation + 1);
+}
+
+/*
+ * Move the completed working entry into the page backed data area at data_head.
+ * The byte budget never exceeds the data area, so adding the entry first evicts every entry the copy
+ * will overwrite; evicted entries live in the data area and need no freeing.
+ */
+static int aesd_mmap_store(struct aesd_dev *dev){
+    struct aesd_buffer_entry entry;
+    char *dst;
+
+    if(dev->entry.size > dev->header->data_size){
+        return -EFBIG;
+    }
+    dst = dev->data + (dev->data_head & (dev->header->data_size - 1));
+    entry.buffptr = dst;
+    entry.size = dev->entry.size;
+
+    aesd_mmap_begin(dev);
+    aesd_buffer_begin(dev);
+    aesd_circular_buffer_add_entry_evict(&dev->buffer, &entry, NULL, 0);
+    aesd_buffer_end(dev);
+    memcpy(dst, dev->entry.buffptr, entry.size);
+    dev->data_head += entry.size;
+    aesd_mmap_end(dev);
 
-    /* Update entry size after successful copy */
-    dev->entry.size = new_size;
+    aesd_payload_free(dev->entry.buffptr);
+    return 0;
+}
+
+/*
+ * Serves write and writev, all user buffers of one call are appended to the working entry.
+ * The first write of a command is copied into an exact sized working entry, later ones into page sized
+ * chunks, so a command streamed in small pieces costs linear copying and newline scanning.
+ */
+static ssize_t aesd_write_iter(struct kiocb *iocb, struct iov_iter *from){
+    ssize_t retval = -ENOMEM;
+    struct aesd_buffer_entry evicted[AESD_EVICT_BATCH];
+    size_t nr_evicted = 0;
+    size_t count = iov_iter_count(from);
+    loff_t pos = iocb->ki_pos;
+    u64 start, lock_wait = 0;
+    bool newline = false;
+    char *tmp;
+    /* Get to aesd_dev using filp->private_data saved in open function */
+    struct aesd_dev *dev = aesd_dev_of(iocb->ki_filp);
+
+    PDEBUG("write %zu bytes with offset %lld",count,iocb->ki_pos);
+
+    if(count == 0){
+        return 0;
+    }
+
+    /* Lock when writting */
+    start = ktime_get_ns();
+    retval = aesd_lock_iocb(dev, iocb, &lock_wait);
+    if(retval){
+        goto out;
+    }
+
+    if(dev->entry.buffptr == NULL){
+        /* First write of a command, usually the whole of it */
+        tmp = aesd_payload_alloc(count);
+        if(tmp == NULL){
+            /* Out of memory failure if no memory allocation failed */
+            retval = -ENOMEM;
+            goto exit;
+        }
+        /* Copy string from user space into the working entry */
+        if(copy_from_iter(tmp, count, from) != count){
+            aesd_payload_free(tmp);
+            retval = -EFAULT;
+            goto exit;
+        }
+        dev->entry.buffptr = tmp;
+        dev->entry.size = count;
+        newline = (memchr(tmp, '\n', count) != NULL);
+    }else{
+        retval = aesd_append_chunks(dev, from, count, &newline);
+        if(retval == -EFAULT){
+            /* If copy fails, drop the whole unfinished command */
+            aesd_discard_partial(dev);
+        }
+        if(retval){
+            goto exit;
+        }
+    }
 
     /* If new_line character was found, save into circular buffer */
-    if(memchr(dev->entry.buffptr, '\n', new_size)){
-        aesd_circular_buffer_add_entry(&dev->buffer, &dev->entry);
+    if(newline){
+        if(aesd_assemble_partial(dev)){
+            /* The command can't be stored without its tail, drop it */
+            aesd_discard_partial(dev);
+            retval = -ENOMEM;
+            goto exit;
+        }
+        if(dev->header != NULL){
+            retval = aesd_mmap_store(dev);
+            if(retval){
+                /* Larger than the whole data area */
+                aesd_discard_partial(dev);
+                goto exit;
+            }
+        }else{
+            /* Oldest entries make room by count and byte budget, their payloads are retired after unlocking */
+            aesd_buffer_begin(dev);
+            nr_evicted = aesd_circular_buffer_add_entry_evict(&dev->buffer, &dev->entry, evicted, AESD_EVICT_BATCH);
+            aesd_buffer_end(dev);
+        }
+        this_cpu_inc(dev->stats->commits);
+        trace_aesd_commit(aesd_minor_of(dev), dev->buffer.next_seq - 1, dev->entry.size, nr_evicted);
         dev->entry.buffptr = NULL;
         dev->entry.size = 0;
     }
 
     /* Return bytes saved on the entry (count) */
     retval = count;
-    *f_pos += count;
+    iocb->ki_pos += count;
 
     exit:
     mutex_unlock(&dev->mutex);
+    /* Wake followers and pollers once a write command was stored */
+    if( (retval > 0) && newline ){
+        wake_up_interruptible(&dev->wait);
+    }
+    aesd_release_evicted(dev, evicted, nr_evicted);
+
+    out:
+    this_cpu_inc(dev->stats->writes);
+    if(retval > 0){
+        this_cpu_add(dev->stats->write_bytes, retval);
+    }
+    this_cpu_inc(dev->stats->write_ns[aesd_hist_bucket(ktime_get_ns() - start)]);
+    trace_aesd_write(aesd_minor_of(dev), pos, count, retval, lock_wait);
     return retval;
 }
 
+/* Move the file position, carrying the follow mode cursor along */
+static void aesd_set_pos(struct file *filp, loff_t pos){
+    struct aesd_file *file = filp->private_data;
+
+    filp->f_pos = pos;
+    if(file->follow){
+        aesd_follow_fpos(file->dev, file, pos);
+    }
+}
+
 static loff_t aesd_seek(struct file *filp, loff_t off, int whence){
-    struct aesd_dev *dev = filp->private_data;
+    struct aesd_dev *dev = aesd_dev_of(filp);
     loff_t newpos;
+    unsigned int seq;
 
     PDEBUG("seek offset %lld whence %d", off, whence);
 
-    if(mutex_lock_interruptible(&dev->mutex)){
-        return -ERESTARTSYS;
-    }
-
     switch(whence){
         case 0: /* SEEK_SET */
             newpos = off;
@@ -171,67 +767,136 @@ static loff_t aesd_seek(struct file *filp, loff_t off, int whence){
             newpos = filp->f_pos + off;
             break;
         case 2: /* SEEK_END */
-            newpos = aesd_circular_buffer_calculate_size(&dev->buffer) + off;
+            do{
+                seq = read_seqcount_begin(&dev->seq);
+                newpos = (loff_t)aesd_circular_buffer_calculate_size(&dev->buffer) + off;
+            }while(read_seqcount_retry(&dev->seq, seq));
             break;
         default: /* Invalid argument */
-            mutex_unlock(&dev->mutex);
-            return -EINVAL;
+            newpos = -EINVAL;
+            goto out;
     }
 
     if (newpos < 0){
-        mutex_unlock(&dev->mutex);
-        return -EINVAL;
+        newpos = -EINVAL;
+        goto out;
     }
 
-    filp->f_pos = newpos;
+    aesd_set_pos(filp, newpos);
     PDEBUG("seek complete, new position %lld", newpos);
-    mutex_unlock(&dev->mutex);
+
+    out:
+    this_cpu_inc(dev->stats->seeks);
+    trace_aesd_seek(aesd_minor_of(dev), off, whence, newpos);
     return newpos;
 }
 
 static long aesd_adjust_file_offset(struct file *filp, unsigned int write_cmd, unsigned int write_cmd_offset){
-    struct aesd_dev *dev = filp->private_data;
-    long retval = 0;
-    size_t count;
-    size_t entry_pos_off;
-    loff_t cmd_offset = 0;
-    unsigned int index;
+    struct aesd_dev *dev = aesd_dev_of(filp);
+    size_t cmd_offset;
+    unsigned int seq;
+    bool found;
 
-    if(mutex_lock_interruptible(&dev->mutex)){
-        return -ERESTARTSYS;
+    /*
+     * Translate command and offset using the buffer's cumulative offsets,
+     * return invalid argument if either exceeds what is stored
+     */
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        found = aesd_circular_buffer_fpos_for_entry(&dev->buffer, write_cmd, write_cmd_offset, &cmd_offset);
+    }while(read_seqcount_retry(&dev->seq, seq));
+    if(!found){
+        return -EINVAL;
     }
 
-    /* Determine total number of entries saved inside circular buffer */
-    count = dev->buffer.full ? AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED : dev->buffer.in_offs;
-    
-    /* If write_cmd exceeds total number of entries, return invalid argument */
-    if(write_cmd >= count){
-        retval = -EINVAL;
-        goto out;
-    }
-    
-    /* Find write command according to offset */
-    entry_pos_off = (dev->buffer.out_offs + write_cmd) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-    
-    /* If write_cmd_offset exceeds entry size, return invalid argument */
-    if (write_cmd_offset >= dev->buffer.entry[entry_pos_off].size){
-        retval = -EINVAL;
-        goto out;
+    aesd_set_pos(filp, cmd_offset);
+    return 0;
+}
+
+static long aesd_seek_when(struct file *filp, unsigned int cmd, struct aesd_seekwhen *when){
+    struct aesd_dev *dev = aesd_dev_of(filp);
+    struct aesd_buffer_entry *entry;
+    struct aesd_seekwhen found;
+    unsigned int seq;
+    size_t fpos;
+
+    /* Entries are ordered by both, direct index for sequence numbers and binary search for time */
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        if(cmd == AESDCHAR_IOCSEEKSEQ){
+            entry = aesd_circular_buffer_find_entry_for_seq(&dev->buffer, when->seq, &fpos);
+        }else{
+            entry = aesd_circular_buffer_find_entry_for_time(&dev->buffer, when->timestamp, &fpos);
+        }
+        if(entry != NULL){
+            found.seq = entry->seq;
+            found.timestamp = entry->timestamp;
+        }
+    }while(read_seqcount_retry(&dev->seq, seq));
+    if(entry == NULL){
+        return -EINVAL;
     }
 
-    for(index = 0; index < write_cmd; index++){
-        size_t cmd_index = (dev->buffer.out_offs + index) % AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
-        cmd_offset += dev->buffer.entry[cmd_index].size;
+    aesd_set_pos(filp, fpos);
+    *when = found;
+    return 0;
+}
+
+/* Describe the stored write commands from meta->first_entry on, sampled in one consistent pass */
+static long aesd_get_metadata(struct file *filp, struct aesd_metadata *meta){
+    struct aesd_dev *dev = aesd_dev_of(filp);
+    struct aesd_buffer_entry *entry;
+    struct aesd_entry_meta *table = NULL;
+    size_t max = min_t(size_t, meta->max_entries, AESD_METADATA_MAX_ENTRIES);
+    size_t count, base, i, nr;
+    unsigned int seq;
+    long retval = 0;
+
+    if(max > 0){
+        table = kvmalloc_array(max, sizeof(struct aesd_entry_meta), GFP_KERNEL);
+        if(table == NULL){
+            return -ENOMEM;
+        }
     }
-    
-    filp->f_pos = cmd_offset + write_cmd_offset;
 
-    out:
-    mutex_unlock(&dev->mutex);
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        count = aesd_circular_buffer_entry_count(&dev->buffer);
+        meta->nr_entries = count;
+        meta->total_size = aesd_circular_buffer_calculate_size(&dev->buffer);
+        meta->generation = dev->generation;
+        /* Offsets relative to the oldest entry, as the cumulative offsets of fpos lookups */
+        base = dev->buffer.entry[dev->buffer.out_offs].cumulative_offs;
+        for(i = meta->first_entry, nr = 0; (i < count) && (nr < max); i++, nr++){
+            entry = &dev->buffer.entry[(dev->buffer.out_offs + i) & dev->buffer.mask];
+            table[nr].offset = entry->cumulative_offs - base;
+            table[nr].size = entry->size;
+            table[nr].seq = entry->seq;
+            table[nr].timestamp = entry->timestamp;
+        }
+    }while(read_seqcount_retry(&dev->seq, seq));
+
+    meta->max_entries = nr;
+    meta->reserved = 0;
+    if( (nr > 0) && (copy_to_user(u64_to_user_ptr(meta->entries), table, nr * sizeof(struct aesd_entry_meta)) != 0) ){
+        retval = -EFAULT;
+    }
+    kvfree(table);
     return retval;
 }
 
-static long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg){
+static long aesd_set_follow(struct file *filp, bool follow){
+    struct aesd_file *file = filp->private_data;
+
+    /* Follow from the write command at the current position on */
+    if(follow && !file->follow){
+        aesd_follow_fpos(file->dev, file, filp->f_pos);
+    }
+    file->follow = follow;
+    return 0;
+}
+
+static long aesd_ioctl_cmd(struct file *filp, unsigned int cmd, unsigned long arg){
     long retval = 0;
 
     switch(cmd){
@@ -245,6 +910,40 @@ static long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg){
             }
             break;
 
+        case AESDCHAR_IOCSEEKSEQ:
+        case AESDCHAR_IOCSEEKTIME:
+            struct aesd_seekwhen when;
+
+            if( copy_from_user(&when, (const void __user *)arg, sizeof(when)) != 0 ){
+                return -EFAULT;
+            }
+            retval = aesd_seek_when(filp, cmd, &when);
+            if( (retval == 0) && (copy_to_user((void __user *)arg, &when, sizeof(when)) != 0) ){
+                retval = -EFAULT;
+            }
+            break;
+
+        case AESDCHAR_IOCMETADATA:
+            struct aesd_metadata meta;
+
+            if( copy_from_user(&meta, (const void __user *)arg, sizeof(meta)) != 0 ){
+                return -EFAULT;
+            }
+            retval = aesd_get_metadata(filp, &meta);
+            if( (retval == 0) && (copy_to_user((void __user *)arg, &meta, sizeof(meta)) != 0) ){
+                retval = -EFAULT;
+            }
+            break;
+
+        case AESDCHAR_IOCFOLLOW:
+            uint32_t follow;
+
+            if( get_user(follow, (uint32_t __user *)arg) != 0 ){
+                return -EFAULT;
+            }
+            retval = aesd_set_follow(filp, follow != 0);
+            break;
+
         default:
             return -ENOTTY;
     }
@@ -252,18 +951,115 @@ static long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg){
     return retval;
 }
 
+static long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg){
+    struct aesd_dev *dev = aesd_dev_of(filp);
+    long retval = aesd_ioctl_cmd(filp, cmd, arg);
+
+    this_cpu_inc(dev->stats->ioctls);
+    trace_aesd_ioctl(aesd_minor_of(dev), cmd, retval);
+    return retval;
+}
+
+/* Map the header page and the data area twice, read-only, see struct aesd_mmap_header */
+static int aesd_mmap(struct file *filp, struct vm_area_struct *vma){
+    struct aesd_dev *dev = aesd_dev_of(filp);
+
+    if(dev->pages == NULL){
+        return -ENODEV;
+    }
+    if(vma->vm_flags & VM_WRITE){
+        return -EPERM;
+    }
+    /* vm_flags became read-only in 6.3, changed through vm_flags_mod() since */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+    vm_flags_mod(vma, VM_DONTEXPAND, VM_MAYWRITE);
+#else
+    vma->vm_flags |= VM_DONTEXPAND;
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+    /* Fails with -ENXIO when the requested range goes past the last page */
+    return vm_map_pages(vma, dev->pages, 1 + (2 * dev->nr_data_pages));
+}
+
 struct file_operations aesd_fops = {
     .owner =    THIS_MODULE,
-    .read =     aesd_read,
-    .write =    aesd_write,
+    .read_iter =    aesd_read_iter,
+    .write_iter =   aesd_write_iter,
     .open =     aesd_open,
     .release =  aesd_release,
     .unlocked_ioctl = aesd_ioctl,
     .llseek = aesd_seek,
+    .mmap = aesd_mmap,
+    .poll = aesd_poll,
+    /* splice and sendfile go through read_iter/write_iter on pipe pages, no copy through userspace */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,5,0)
+    .splice_read = copy_splice_read,
+#else
+    .splice_read = generic_file_splice_read, // Also read_iter based before 6.5
+#endif
+    .splice_write = iter_file_splice_write,
 };
 
-static int aesd_setup_cdev(struct aesd_dev *dev){
-    int err, devno = MKDEV(aesd_major, aesd_minor);
+/* Free the page backed storage, safe on a partly set up device */
+static void aesd_mmap_teardown(struct aesd_dev *dev){
+    unsigned long i;
+
+    if(dev->pages == NULL){
+        return;
+    }
+    if(dev->data != NULL){
+        vunmap(dev->data);
+    }
+    /* Header and data pages, the second run of data pages repeats the first */
+    for(i = 0; i <= dev->nr_data_pages; i++){
+        if(dev->pages[i] != NULL){
+            __free_page(dev->pages[i]);
+        }
+    }
+    kvfree(dev->pages);
+    dev->pages = NULL;
+    dev->header = NULL;
+    dev->data = NULL;
+}
+
+/* Allocate the header page and bytes of data pages, mapped twice in a row into the kernel as well */
+static int aesd_mmap_setup(struct aesd_dev *dev, unsigned long bytes){
+    unsigned long i, nr = bytes >> PAGE_SHIFT;
+
+    if( !is_power_of_2(bytes) || (bytes < PAGE_SIZE) || (nr > (UINT_MAX / 2)) ){
+        return -EINVAL;
+    }
+    dev->pages = kvcalloc(1 + (2 * nr), sizeof(struct page *), GFP_KERNEL);
+    if(dev->pages == NULL){
+        return -ENOMEM;
+    }
+    dev->nr_data_pages = nr;
+    for(i = 0; i <= nr; i++){
+        dev->pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+        if(dev->pages[i] == NULL){
+            aesd_mmap_teardown(dev);
+            return -ENOMEM;
+        }
+    }
+    for(i = 0; i < nr; i++){
+        dev->pages[1 + nr + i] = dev->pages[1 + i];
+    }
+    dev->data = vmap(&dev->pages[1], 2 * nr, VM_MAP, PAGE_KERNEL);
+    if(dev->data == NULL){
+        aesd_mmap_teardown(dev);
+        return -ENOMEM;
+    }
+
+    dev->header = page_address(dev->pages[0]);
+    dev->header->magic = AESD_MMAP_MAGIC;
+    dev->header->version = AESD_MMAP_VERSION;
+    dev->header->data_size = bytes;
+    dev->data_head = 0;
+    return 0;
+}
+
+static int aesd_setup_cdev(struct aesd_dev *dev, int index){
+    int err, devno = MKDEV(aesd_major, aesd_minor + index);
 
     // Initialize cdev structure and allocates memory
     cdev_init(&dev->cdev, &aesd_fops);
@@ -273,58 +1069,344 @@ static int aesd_setup_cdev(struct aesd_dev *dev){
     // Add device to the system
     err = cdev_add(&dev->cdev, devno, 1);
     if (err) {
-        printk(KERN_ERR "Error %d adding aesd cdev", err);
+        printk(KERN_ERR "Error %d adding aesd%d", err, index);
     }
     return err;
 }
 
+/* Initialize the ring, entry storage and locks of one device, undone by aesd_free_device() */
+static int aesd_init_device(struct aesd_dev *dev){
+    int result;
+    unsigned long max_bytes = aesd_max_bytes; // Byte budget of the circular buffer
+
+    dev->stats = alloc_percpu(struct aesd_stats);
+    if(dev->stats == NULL){
+        return -ENOMEM;
+    }
+    result = init_srcu_struct(&dev->srcu);
+    if(result){
+        goto fail_stats;
+    }
+    // Initialize device auxiliary structures, with entry storage of aesd_history slots when requested
+    if(aesd_history == 0){
+        aesd_circular_buffer_init(&dev->buffer);
+    }else{
+        dev->history = kvcalloc(aesd_history, sizeof(struct aesd_buffer_entry), GFP_KERNEL);
+        if(dev->history == NULL){
+            result = -ENOMEM;
+            goto fail_srcu;
+        }
+        aesd_circular_buffer_init_capacity(&dev->buffer, dev->history, aesd_history);
+    }
+    // Commands move into page backed storage for mmap when requested, its size caps the byte budget
+    if(aesd_mmap_bytes != 0){
+        result = aesd_mmap_setup(dev, aesd_mmap_bytes);
+        if(result){
+            goto fail_history;
+        }
+        if( (max_bytes == 0) || (max_bytes > aesd_mmap_bytes) ){
+            max_bytes = aesd_mmap_bytes;
+        }
+    }
+    aesd_circular_buffer_set_limits(&dev->buffer, max_bytes, 0);
+    memset(&dev->entry, 0, sizeof(struct aesd_buffer_entry));
+    INIT_LIST_HEAD(&dev->chunks);
+    init_waitqueue_head(&dev->wait);
+    mutex_init(&dev->mutex);
+    seqcount_mutex_init(&dev->seq, &dev->mutex);
+    return 0;
+
+    fail_history:
+    kvfree(dev->history);
+    dev->history = NULL;
+    fail_srcu:
+    cleanup_srcu_struct(&dev->srcu);
+    fail_stats:
+    free_percpu(dev->stats);
+    dev->stats = NULL;
+    return result;
+}
+
+static void aesd_free_device(struct aesd_dev *dev){
+    uint32_t index;
+    struct aesd_buffer_entry *tmp_entry;
+
+    /* Destroy locking device and free memory of working entry and its chunks */
+    mutex_destroy(&dev->mutex);
+    aesd_discard_partial(dev);
+
+    /* Let retired payloads be freed, then deallocate memory inside circular buffer */
+    srcu_barrier(&dev->srcu);
+    if(dev->header == NULL){
+        AESD_CIRCULAR_BUFFER_FOREACH(tmp_entry, &dev->buffer, index){
+            aesd_payload_free(tmp_entry->buffptr);
+        }
+    }
+    cleanup_srcu_struct(&dev->srcu);
+    aesd_mmap_teardown(dev);
+    kvfree(dev->history);
+    free_percpu(dev->stats);
+}
+
+/* Print the non-empty buckets of a latency histogram as "name lower_bound_ns count" lines */
+static void aesd_show_hist(struct seq_file *s, const char *name, const u64 *hist){
+    unsigned int i;
+
+    for(i = 0; i < AESD_HIST_BUCKETS; i++){
+        if(hist[i] != 0){
+            seq_printf(s, "%s %llu %llu\n", name, 1ULL << i, hist[i]);
+        }
+    }
+}
+
+/* aesdchar/aesdcharN/stats: stored contents, then the per CPU statistics summed up */
+static int aesd_stats_show(struct seq_file *s, void *unused){
+    struct aesd_dev *dev = s->private;
+    struct aesd_stats *sum;
+    const u64 *cpu_stats;
+    u64 *total;
+    size_t entries, bytes, i;
+    uint64_t generation;
+    unsigned int seq;
+    int cpu;
+
+    sum = kzalloc(sizeof(struct aesd_stats), GFP_KERNEL);
+    if(sum == NULL){
+        return -ENOMEM;
+    }
+    total = (u64 *)sum;
+    for_each_possible_cpu(cpu){
+        cpu_stats = (const u64 *)per_cpu_ptr(dev->stats, cpu);
+        for(i = 0; i < sizeof(struct aesd_stats) / sizeof(u64); i++){
+            total[i] += cpu_stats[i];
+        }
+    }
+    do{
+        seq = read_seqcount_begin(&dev->seq);
+        entries = aesd_circular_buffer_entry_count(&dev->buffer);
+        bytes = aesd_circular_buffer_calculate_size(&dev->buffer);
+        generation = dev->generation;
+    }while(read_seqcount_retry(&dev->seq, seq));
+
+    seq_printf(s, "entries %zu\nbytes %zu\ngeneration %llu\n", entries, bytes, generation);
+    seq_printf(s, "reads %llu\nread_bytes %llu\nwrites %llu\nwrite_bytes %llu\n",
+            sum->reads, sum->read_bytes, sum->writes, sum->write_bytes);
+    seq_printf(s, "commits %llu\nevictions %llu\nseeks %llu\nioctls %llu\n",
+            sum->commits, sum->evictions, sum->seeks, sum->ioctls);
+    aesd_show_hist(s, "read_ns", sum->read_ns);
+    aesd_show_hist(s, "write_ns", sum->write_ns);
+    aesd_show_hist(s, "lock_wait_ns", sum->lock_wait_ns);
+    kfree(sum);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(aesd_stats);
+
+/* aesdchar/memory: aesd_mem_held and aesd_mem_peak */
+static int aesd_memory_show(struct seq_file *s, void *unused){
+    seq_printf(s, "held %ld\npeak %ld\n", atomic_long_read(&aesd_mem_held), atomic_long_read(&aesd_mem_peak));
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(aesd_memory);
+
+/* Failures only cost the statistics, debugfs calls accept the error pointers earlier ones return */
+static void aesd_debugfs_setup(void){
+    struct dentry *dir;
+    char name[16];
+    int i;
+
+    aesd_debugfs = debugfs_create_dir("aesdchar", NULL);
+    debugfs_create_file("memory", 0444, aesd_debugfs, NULL, &aesd_memory_fops);
+    for(i = 0; i < aesd_nr_devs; i++){
+        snprintf(name, sizeof(name), "aesdchar%d", i);
+        dir = debugfs_create_dir(name, aesd_debugfs);
+        debugfs_create_file("stats", 0444, dir, &aesd_devices[i], &aesd_stats_fops);
+    }
+}
+
+/* Entries the shrinker may evict: all but the newest of every device with kmalloc'd payloads */
+static unsigned long aesd_shrink_count(struct shrinker *shrink, struct shrink_control *sc){
+    struct aesd_dev *dev;
+    unsigned long count = 0;
+    unsigned int seq;
+    size_t entries;
+    int i;
+
+    for(i = 0; i < aesd_nr_devs; i++){
+        dev = &aesd_devices[i];
+        /* Page backed storage has a fixed size, evicting from it gives nothing back */
+        if(dev->header != NULL){
+            continue;
+        }
+        do{
+            seq = read_seqcount_begin(&dev->seq);
+            entries = aesd_circular_buffer_entry_count(&dev->buffer);
+        }while(read_seqcount_retry(&dev->seq, seq));
+        if(entries > 1){
+            count += entries - 1;
+        }
+    }
+    return count ? count : SHRINK_EMPTY;
+}
+
+/* Evict up to nr_to_scan of the oldest entries, their payloads are freed after the SRCU grace period */
+static unsigned long aesd_shrink_scan(struct shrinker *shrink, struct shrink_control *sc){
+    struct aesd_buffer_entry evicted[AESD_EVICT_BATCH];
+    struct aesd_dev *dev;
+    unsigned long freed = 0;
+    size_t nr_evicted, j;
+    int i;
+
+    for(i = 0; (i < aesd_nr_devs) && (freed < sc->nr_to_scan); i++){
+        dev = &aesd_devices[i];
+        /* Writers allocate with the mutex held and may be the ones reclaiming, never wait for it */
+        if( (dev->header != NULL) || !mutex_trylock(&dev->mutex) ){
+            continue;
+        }
+        do{
+            aesd_buffer_begin(dev);
+            nr_evicted = aesd_circular_buffer_evict_oldest(&dev->buffer, evicted,
+                    min_t(unsigned long, AESD_EVICT_BATCH, sc->nr_to_scan - freed));
+            aesd_buffer_end(dev);
+            for(j = 0; j < nr_evicted; j++){
+                aesd_payload_retire(dev, &evicted[j], true);
+            }
+            freed += nr_evicted;
+        }while( (nr_evicted == AESD_EVICT_BATCH) && (freed < sc->nr_to_scan) );
+        mutex_unlock(&dev->mutex);
+    }
+    return freed ? freed : SHRINK_STOP;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,7,0)
+/* Before 6.7 shrinkers are caller allocated, aesd_shrinker points here once registered */
+static struct shrinker aesd_shrinker_static = {
+    .count_objects = aesd_shrink_count,
+    .scan_objects = aesd_shrink_scan,
+    .seeks = DEFAULT_SEEKS,
+};
+#endif
+
+/* Devices keep working without a shrinker, only memory pressure can't trim them */
+static void aesd_shrinker_setup(void){
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,7,0)
+    aesd_shrinker = shrinker_alloc(0, "aesdchar");
+    if(aesd_shrinker != NULL){
+        aesd_shrinker->count_objects = aesd_shrink_count;
+        aesd_shrinker->scan_objects = aesd_shrink_scan;
+        shrinker_register(aesd_shrinker);
+    }
+#else
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,0,0)
+    int result = register_shrinker(&aesd_shrinker_static, "aesdchar");
+#else
+    int result = register_shrinker(&aesd_shrinker_static);
+#endif
+    aesd_shrinker = result ? NULL : &aesd_shrinker_static;
+#endif
+    if(aesd_shrinker == NULL){
+        printk(KERN_WARNING "aesdchar: no shrinker, entries are only evicted by the history limits\n");
+    }
+}
+
+static void aesd_shrinker_teardown(void){
+    if(aesd_shrinker == NULL){
+        return;
+    }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,7,0)
+    shrinker_free(aesd_shrinker);
+#else
+    unregister_shrinker(aesd_shrinker);
+#endif
+    aesd_shrinker = NULL;
+}
+
 static int aesd_init_module(void){
     dev_t dev = 0; // Variable to hold device numbers (both major and minor parts)
     int result; // Variable used to hold function outputs
+    int i;
 
-    result = alloc_chrdev_region(&dev, aesd_minor, 1, "aesdchar"); // Get a major number dynamically
+    // Settings shared by all devices, checked once
+    if( (aesd_nr_devs < 1) || (aesd_nr_devs > AESD_MAX_DEVS) ){
+        printk(KERN_WARNING "aesd_nr_devs %d is not between 1 and %d\n", aesd_nr_devs, AESD_MAX_DEVS);
+        return -EINVAL;
+    }
+    if( (aesd_history != 0) && (!is_power_of_2(aesd_history) || (aesd_history > AESD_CIRCULAR_BUFFER_MAX_CAPACITY)) ){
+        printk(KERN_WARNING "aesd_history %u is not a power of two\n", aesd_history);
+        return -EINVAL;
+    }
+    if( (aesd_mmap_bytes != 0) && (!is_power_of_2(aesd_mmap_bytes) || (aesd_mmap_bytes < PAGE_SIZE)) ){
+        printk(KERN_WARNING "aesd_mmap_bytes %lu is not a power of two multiple of the page size\n", aesd_mmap_bytes);
+        return -EINVAL;
+    }
+
+    aesd_payload_cache = kmem_cache_create("aesd_payload", AESD_PAYLOAD_SLAB_SIZE, 0, 0, NULL);
+    if(aesd_payload_cache == NULL){
+        return -ENOMEM;
+    }
+
+    result = alloc_chrdev_region(&dev, aesd_minor, aesd_nr_devs, "aesdchar"); // Get a major number dynamically
     aesd_major = MAJOR(dev);
     if (result < 0) {
         printk(KERN_WARNING "Can't get major %d\n", aesd_major);
+        kmem_cache_destroy(aesd_payload_cache);
         return result;
     }
 
-    memset(&aesd_device,0,sizeof(struct aesd_dev)); // Set aesd_device structure to 0 for clean start
+    // Zeroed structures for a clean start
+    aesd_devices = kcalloc(aesd_nr_devs, sizeof(struct aesd_dev), GFP_KERNEL);
+    if(aesd_devices == NULL){
+        unregister_chrdev_region(dev, aesd_nr_devs);
+        kmem_cache_destroy(aesd_payload_cache);
+        return -ENOMEM;
+    }
 
-    // Initialize device auxiliary structures
-    aesd_circular_buffer_init(&aesd_device.buffer);
-    memset(&aesd_device.entry, 0, sizeof(struct aesd_buffer_entry));
-    mutex_init(&aesd_device.mutex);
+    // Initilize every device, each gets its own minor
+    for(i = 0; i < aesd_nr_devs; i++){
+        result = aesd_init_device(&aesd_devices[i]);
+        if(result){
+            goto fail;
+        }
+        result = aesd_setup_cdev(&aesd_devices[i], i);
+        if(result){
+            aesd_free_device(&aesd_devices[i]);
+            goto fail;
+        }
+    }
 
-    // Initilize aesd_device
-    result = aesd_setup_cdev(&aesd_device);
+    aesd_shrinker_setup();
+    aesd_debugfs_setup();
+    return 0;
 
-    if( result ) {
-        mutex_destroy(&aesd_device.mutex);
-        unregister_chrdev_region(dev, 1);
+    fail:
+    while(i-- > 0){
+        cdev_del(&aesd_devices[i].cdev);
+        aesd_free_device(&aesd_devices[i]);
     }
+    kfree(aesd_devices);
+    unregister_chrdev_region(dev, aesd_nr_devs);
+    kmem_cache_destroy(aesd_payload_cache);
     return result;
-
 }
 
 static void aesd_cleanup_module(void){
     dev_t devno = MKDEV(aesd_major, aesd_minor);
-    /* Remove char device from the system */
-    cdev_del(&aesd_device.cdev);
+    int i;
 
-    /* Destroy locking device and free memory of working entry */
-    mutex_destroy(&aesd_device.mutex);
-    kfree(aesd_device.entry.buffptr);
-
-    /* Deallocate memory inside circular buffer */
-    uint8_t index;
-    struct aesd_buffer_entry *tmp_entry;
-    AESD_CIRCULAR_BUFFER_FOREACH(tmp_entry, &aesd_device.buffer, index){
-        kfree(tmp_entry->buffptr);
+    // Before the devices go away, readers of open stats files get -EIO from then on
+    debugfs_remove_recursive(aesd_debugfs);
+    // Same for the shrinker, unregistering waits for running callbacks
+    aesd_shrinker_teardown();
+    for(i = 0; i < aesd_nr_devs; i++){
+        /* Remove char device from the system */
+        cdev_del(&aesd_devices[i].cdev);
+        aesd_free_device(&aesd_devices[i]);
     }
+    kfree(aesd_devices);
+    // Every payload was freed with its device, retired ones included
+    kmem_cache_destroy(aesd_payload_cache);
 
     // Free device numbers once device is no longer in use
-    unregister_chrdev_region(devno, 1);
+    unregister_chrdev_region(devno, aesd_nr_devs);
 }
 
 module_init(aesd_init_module);
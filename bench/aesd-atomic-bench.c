@@ -0,0 +1,253 @@
+/*
+ * aesd-atomic-bench.c
+ *
+ * Contention benchmark of the lock-free aesd_atomic_ring against the
+ * baseline it replaces: an aesd_circular_buffer of malloc'd payload copies
+ * behind one pthread mutex, the way aesdsocket shares its storage.
+ *
+ * Producers add fixed size entries as fast as they can while readers follow
+ * the stream with their own cursor, copying every entry still held and
+ * skipping overwritten ones.  Both rings do the same work per entry: one
+ * payload copy in, one payload copy out per reader.  Reported are adds and
+ * reads per second and how many entries readers lost to overwrites.
+ *
+ * Usage: aesd-atomic-bench [-p producers] [-r readers] [-d seconds]
+ *                          [-c capacity] [-s entry_size]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../aesd-char-driver/aesd-circular-atomic.h"
+#include "../aesd-char-driver/aesd-circular-buffer.h"
+
+#define MAX_THREADS 64
+
+struct bench_config{
+    int producers;
+    int readers;
+    double seconds;
+    uint32_t capacity;
+    size_t entry_size;
+};
+
+/* Mutex protected baseline, the reader cursor counts entries ever added */
+struct locked_ring{
+    pthread_mutex_t mutex;
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry *storage;
+    uint64_t added;
+};
+
+struct bench_state{
+    const struct bench_config *config;
+    struct aesd_atomic_ring *atomic;
+    struct locked_ring locked;
+    atomic_bool stop;
+    _Atomic uint64_t adds;
+    _Atomic uint64_t reads;
+    _Atomic uint64_t lost;
+};
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void *atomic_producer(void *arg){
+    struct bench_state *state = arg;
+    char *buf = calloc(1, state->config->entry_size);
+    uint64_t adds = 0;
+
+    while(!atomic_load_explicit(&state->stop, memory_order_relaxed)){
+        memcpy(buf, &adds, (state->config->entry_size < sizeof(adds)) ? state->config->entry_size : sizeof(adds));
+        aesd_atomic_ring_add(state->atomic, buf, state->config->entry_size, NULL);
+        adds++;
+    }
+    atomic_fetch_add(&state->adds, adds);
+    free(buf);
+    return NULL;
+}
+
+static void *atomic_reader(void *arg){
+    struct bench_state *state = arg;
+    struct aesd_atomic_cursor cursor;
+    char *buf = malloc(state->config->entry_size);
+    uint64_t reads = 0;
+    size_t size;
+
+    aesd_atomic_cursor_init(state->atomic, &cursor);
+    while(!atomic_load_explicit(&state->stop, memory_order_relaxed)){
+        if(aesd_atomic_ring_next(state->atomic, &cursor, buf, state->config->entry_size, &size) == AESD_ATOMIC_OK){
+            reads++;
+        }
+    }
+    atomic_fetch_add(&state->reads, reads);
+    atomic_fetch_add(&state->lost, cursor.lost);
+    free(buf);
+    return NULL;
+}
+
+static void *locked_producer(void *arg){
+    struct bench_state *state = arg;
+    struct locked_ring *ring = &state->locked;
+    struct aesd_buffer_entry entry, evicted;
+    uint64_t adds = 0;
+
+    while(!atomic_load_explicit(&state->stop, memory_order_relaxed)){
+        char *copy = malloc(state->config->entry_size);
+        memset(copy, 0, state->config->entry_size);
+        memcpy(copy, &adds, (state->config->entry_size < sizeof(adds)) ? state->config->entry_size : sizeof(adds));
+        entry.buffptr = copy;
+        entry.size = state->config->entry_size;
+
+        evicted.buffptr = NULL;
+        pthread_mutex_lock(&ring->mutex);
+        aesd_circular_buffer_add_entry_evict(&ring->buffer, &entry, &evicted, 1);
+        ring->added++;
+        pthread_mutex_unlock(&ring->mutex);
+        free((void *)evicted.buffptr);
+        adds++;
+    }
+    atomic_fetch_add(&state->adds, adds);
+    return NULL;
+}
+
+static void *locked_reader(void *arg){
+    struct bench_state *state = arg;
+    struct locked_ring *ring = &state->locked;
+    char *buf = malloc(state->config->entry_size);
+    uint64_t next = 0, reads = 0, lost = 0;
+
+    while(!atomic_load_explicit(&state->stop, memory_order_relaxed)){
+        uint64_t count, oldest;
+
+        pthread_mutex_lock(&ring->mutex);
+        count = aesd_circular_buffer_entry_count(&ring->buffer);
+        oldest = ring->added - count;
+        if(next < oldest){
+            lost += oldest - next;
+            next = oldest;
+        }
+        if(next < ring->added){
+            struct aesd_buffer_entry *entry =
+                    &ring->buffer.entry[(ring->buffer.out_offs + (next - oldest)) & ring->buffer.mask];
+            memcpy(buf, entry->buffptr, entry->size);
+            next++;
+            reads++;
+        }
+        pthread_mutex_unlock(&ring->mutex);
+    }
+    atomic_fetch_add(&state->reads, reads);
+    atomic_fetch_add(&state->lost, lost);
+    free(buf);
+    return NULL;
+}
+
+static int run(const char *name, const struct bench_config *config,
+               void *(*producer)(void *), void *(*reader)(void *), struct bench_state *state){
+    pthread_t threads[MAX_THREADS];
+    int started = 0, i;
+    struct timespec pause;
+    double start, elapsed;
+
+    state->config = config;
+    atomic_init(&state->stop, false);
+    atomic_init(&state->adds, 0);
+    atomic_init(&state->reads, 0);
+    atomic_init(&state->lost, 0);
+
+    start = now_s();
+    for(i = 0; i < config->readers; i++){
+        if(pthread_create(&threads[started], NULL, reader, state) == 0){
+            started++;
+        }
+    }
+    for(i = 0; i < config->producers; i++){
+        if(pthread_create(&threads[started], NULL, producer, state) == 0){
+            started++;
+        }
+    }
+
+    pause.tv_sec = (time_t)config->seconds;
+    pause.tv_nsec = (long)((config->seconds - pause.tv_sec) * 1e9);
+    nanosleep(&pause, NULL);
+    atomic_store(&state->stop, true);
+    for(i = 0; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = now_s() - start;
+
+    if(started != config->producers + config->readers){
+        fprintf(stderr, "%s: only %d threads started\n", name, started);
+        return -1;
+    }
+    printf("%-7s adds=%.0f/s reads=%.0f/s lost=%.1f%%\n", name,
+            atomic_load(&state->adds) / elapsed, atomic_load(&state->reads) / elapsed,
+            100.0 * atomic_load(&state->lost) /
+            ((atomic_load(&state->reads) + atomic_load(&state->lost)) ? (atomic_load(&state->reads) + atomic_load(&state->lost)) : 1));
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    struct bench_config config = { .producers = 1, .readers = 3, .seconds = 2.0, .capacity = 1024, .entry_size = 64 };
+    struct bench_state *state;
+    struct aesd_buffer_entry *evicted;
+    uint32_t index;
+    int opt, rc = 0;
+
+    while( (opt = getopt(argc, argv, "p:r:d:c:s:")) != -1 ){
+        switch(opt){
+            case 'p': config.producers = atoi(optarg); break;
+            case 'r': config.readers = atoi(optarg); break;
+            case 'd': config.seconds = atof(optarg); break;
+            case 'c': config.capacity = strtoul(optarg, NULL, 0); break;
+            case 's': config.entry_size = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-p producers] [-r readers] [-d seconds] [-c capacity] [-s entry_size]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if( (config.producers < 1) || (config.readers < 0) || (config.producers + config.readers > MAX_THREADS) ||
+            (config.seconds <= 0) || (config.entry_size == 0) ){
+        fprintf(stderr, "Need at least one producer, at most %d threads, a positive duration and entry size\n", MAX_THREADS);
+        return 1;
+    }
+
+    if( (state = calloc(1, sizeof(struct bench_state))) == NULL ){
+        perror("calloc");
+        return 1;
+    }
+    state->atomic = aesd_atomic_ring_create(config.capacity, config.entry_size,
+            (config.producers > 1) ? AESD_ATOMIC_MULTI_PRODUCER : AESD_ATOMIC_SINGLE_PRODUCER);
+    state->locked.storage = malloc((size_t)config.capacity * sizeof(struct aesd_buffer_entry));
+    if( (state->atomic == NULL) || (state->locked.storage == NULL) ||
+            !aesd_circular_buffer_init_capacity(&state->locked.buffer, state->locked.storage, config.capacity) ){
+        fprintf(stderr, "Capacity must be a power of two\n");
+        aesd_atomic_ring_destroy(state->atomic);
+        free(state->locked.storage);
+        free(state);
+        return 1;
+    }
+    pthread_mutex_init(&state->locked.mutex, NULL);
+
+    printf("producers=%d readers=%d seconds=%.1f capacity=%u entry_size=%zu\n",
+            config.producers, config.readers, config.seconds, config.capacity, config.entry_size);
+    rc |= run("atomic", &config, atomic_producer, atomic_reader, state);
+    rc |= run("mutex", &config, locked_producer, locked_reader, state);
+
+    AESD_CIRCULAR_BUFFER_FOREACH(evicted, &state->locked.buffer, index){
+        free((void *)evicted->buffptr);
+    }
+    pthread_mutex_destroy(&state->locked.mutex);
+    aesd_atomic_ring_destroy(state->atomic);
+    free(state->locked.storage);
+    free(state);
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * aesd-circular-buffer-bench.c
+ *
+ * Microbenchmarks of aesd_circular_buffer_add_entry(),
+ * aesd_circular_buffer_find_entry_offset_for_fpos() and
+ * aesd_circular_buffer_calculate_size(), to judge buffer layout changes on
+ * data.  Every case is run over a grid of capacities and entry size
+ * distributions, lookups also over fpos access patterns:
+ *   sequential  offsets walking the stored bytes front to back
+ *   random      offsets uniformly spread over the stored bytes
+ *   tail        offsets within the newest few entries, like readers following a writer
+ * Buffers are filled twice over first so measurements run on a wrapped ring.
+ * Each case gets warmup rounds, then repetitions whose min and median
+ * nanoseconds per operation are reported as one JSON object per case.
+ *
+ * Usage: aesd-circular-buffer-bench [-c capacity[,capacity...]] [-n operations]
+ *                                   [-w warmup] [-r repetitions] [-o output.json]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../aesd-char-driver/aesd-circular-buffer.h"
+
+#define MAX_CAPACITIES 16
+#define MAX_ENTRY_SIZE (64 * 1024)
+#define TAIL_ENTRIES 8
+
+enum size_dist { SIZE_FIXED, SIZE_UNIFORM, SIZE_MIXED };
+static const char *size_dist_names[] = { "fixed64", "uniform1k", "mixed" };
+
+enum pattern { PATTERN_SEQUENTIAL, PATTERN_RANDOM, PATTERN_TAIL };
+static const char *pattern_names[] = { "sequential", "random", "tail" };
+
+struct bench_config{
+    uint32_t capacities[MAX_CAPACITIES];
+    int nr_capacities;
+    size_t operations;
+    int warmup;
+    int repetitions;
+};
+
+/* Payload all entries point into, contents are never read */
+static char payload[MAX_ENTRY_SIZE];
+/* Results are folded in here so the compiler can't drop the calls */
+static volatile size_t sink;
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t rng_next(void){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static size_t entry_size(enum size_dist dist){
+    switch(dist){
+        case SIZE_UNIFORM:
+            return 1 + (rng_next() % 1024);
+        case SIZE_MIXED:
+            // Mostly short lines, one in a hundred large writes
+            return (rng_next() % 100) ? 1 + (rng_next() % 80) : MAX_ENTRY_SIZE;
+        default:
+            return 64;
+    }
+}
+
+static void make_entries(struct aesd_buffer_entry *entries, size_t count, enum size_dist dist){
+    for(size_t i = 0; i < count; i++){
+        entries[i].buffptr = payload;
+        entries[i].size = entry_size(dist);
+    }
+}
+
+static void make_offsets(size_t *offsets, size_t count, struct aesd_circular_buffer *buffer, enum pattern pattern){
+    size_t total = aesd_circular_buffer_calculate_size(buffer);
+    size_t entries = aesd_circular_buffer_entry_count(buffer);
+    size_t tail_start = 0, step;
+
+    if(pattern == PATTERN_TAIL){
+        aesd_circular_buffer_fpos_for_entry(buffer, (entries > TAIL_ENTRIES) ? entries - TAIL_ENTRIES : 0, 0, &tail_start);
+    }
+    step = (total / count) ? (total / count) : 1;
+
+    for(size_t i = 0; i < count; i++){
+        switch(pattern){
+            case PATTERN_SEQUENTIAL:
+                offsets[i] = (i * step) % total;
+                break;
+            case PATTERN_RANDOM:
+                offsets[i] = rng_next() % total;
+                break;
+            case PATTERN_TAIL:
+                offsets[i] = tail_start + (rng_next() % (total - tail_start));
+                break;
+        }
+    }
+}
+
+static int compare_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(FILE *out, int *first, const char *op, uint32_t capacity, enum size_dist dist,
+                   const char *pattern, double *samples, int repetitions, size_t operations){
+    qsort(samples, repetitions, sizeof(double), compare_double);
+    fprintf(out, "%s\n  {\"op\": \"%s\", \"capacity\": %u, \"sizes\": \"%s\", \"pattern\": \"%s\", "
+            "\"operations\": %zu, \"repetitions\": %d, \"ns_per_op_min\": %.2f, \"ns_per_op_median\": %.2f}",
+            *first ? "" : ",", op, capacity, size_dist_names[dist], pattern, operations, repetitions,
+            samples[0], samples[repetitions / 2]);
+    *first = 0;
+}
+
+// Function to run every case for one capacity and size distribution, returns -1 on allocation failure
+static int bench_case(FILE *out, int *first, const struct bench_config *config, uint32_t capacity, enum size_dist dist){
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry *storage = malloc((size_t)capacity * sizeof(struct aesd_buffer_entry));
+    struct aesd_buffer_entry *entries = malloc(config->operations * sizeof(struct aesd_buffer_entry));
+    size_t *offsets = malloc(config->operations * sizeof(size_t));
+    double *samples = malloc(config->repetitions * sizeof(double));
+    int rc = -1;
+
+    if( (storage == NULL) || (entries == NULL) || (offsets == NULL) || (samples == NULL) ||
+            !aesd_circular_buffer_init_capacity(&buffer, storage, capacity) ){
+        goto out;
+    }
+
+    make_entries(entries, config->operations, dist);
+    for(size_t i = 0; i < 2 * (size_t)capacity; i++){
+        aesd_circular_buffer_add_entry(&buffer, &entries[i % config->operations]);
+    }
+
+    // add_entry on a full ring, every add overwrites the oldest entry
+    for(int r = -config->warmup; r < config->repetitions; r++){
+        double start = now_ns();
+        for(size_t i = 0; i < config->operations; i++){
+            aesd_circular_buffer_add_entry(&buffer, &entries[i]);
+        }
+        if(r >= 0){
+            samples[r] = (now_ns() - start) / config->operations;
+        }
+    }
+    report(out, first, "add_entry", capacity, dist, "-", samples, config->repetitions, config->operations);
+
+    for(int r = -config->warmup; r < config->repetitions; r++){
+        double start = now_ns();
+        for(size_t i = 0; i < config->operations; i++){
+            sink += aesd_circular_buffer_calculate_size(&buffer);
+        }
+        if(r >= 0){
+            samples[r] = (now_ns() - start) / config->operations;
+        }
+    }
+    report(out, first, "calculate_size", capacity, dist, "-", samples, config->repetitions, config->operations);
+
+    for(enum pattern p = PATTERN_SEQUENTIAL; p <= PATTERN_TAIL; p++){
+        make_offsets(offsets, config->operations, &buffer, p);
+        for(int r = -config->warmup; r < config->repetitions; r++){
+            double start = now_ns();
+            for(size_t i = 0; i < config->operations; i++){
+                size_t entry_offset;
+                struct aesd_buffer_entry *entry =
+                        aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, offsets[i], &entry_offset);
+                sink += entry_offset + (entry != NULL);
+            }
+            if(r >= 0){
+                samples[r] = (now_ns() - start) / config->operations;
+            }
+        }
+        report(out, first, "find_entry_offset_for_fpos", capacity, dist, pattern_names[p],
+                samples, config->repetitions, config->operations);
+    }
+    rc = 0;
+
+out:
+    free(storage);
+    free(entries);
+    free(offsets);
+    free(samples);
+    return rc;
+}
+
+// Function to parse a comma separated capacity list, returns -1 if any is not a power of two
+static int parse_capacities(struct bench_config *config, char *list){
+    char *token, *save;
+
+    config->nr_capacities = 0;
+    for(token = strtok_r(list, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)){
+        unsigned long capacity = strtoul(token, NULL, 0);
+        if( (config->nr_capacities == MAX_CAPACITIES) || (capacity == 0) || (capacity > AESD_CIRCULAR_BUFFER_MAX_CAPACITY) ||
+                ((capacity & (capacity - 1)) != 0) ){
+            return -1;
+        }
+        config->capacities[config->nr_capacities++] = capacity;
+    }
+    return (config->nr_capacities > 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[]){
+    struct bench_config config = {
+        .capacities = { 16, 1024, 65536 },
+        .nr_capacities = 3,
+        .operations = 1 << 20,
+        .warmup = 1,
+        .repetitions = 5,
+    };
+    FILE *out = stdout;
+    int opt, first = 1, rc = 0;
+
+    while( (opt = getopt(argc, argv, "c:n:w:r:o:")) != -1 ){
+        switch(opt){
+            case 'c':
+                if(parse_capacities(&config, optarg) == -1){
+                    fprintf(stderr, "Capacities must be powers of two, at most %d of them\n", MAX_CAPACITIES);
+                    return 1;
+                }
+                break;
+            case 'n': config.operations = strtoul(optarg, NULL, 0); break;
+            case 'w': config.warmup = atoi(optarg); break;
+            case 'r': config.repetitions = atoi(optarg); break;
+            case 'o':
+                if( (out = fopen(optarg, "w")) == NULL ){
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-c capacity[,capacity...]] [-n operations] [-w warmup] [-r repetitions] "
+                        "[-o output.json]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if( (config.operations == 0) || (config.warmup < 0) || (config.repetitions < 1) ){
+        fprintf(stderr, "Need at least one operation and repetition\n");
+        return 1;
+    }
+
+    fprintf(out, "[");
+    for(int c = 0; (c < config.nr_capacities) && (rc == 0); c++){
+        for(enum size_dist d = SIZE_FIXED; (d <= SIZE_MIXED) && (rc == 0); d++){
+            if(bench_case(out, &first, &config, config.capacities[c], d) == -1){
+                perror("malloc");
+                rc = 1;
+            }
+        }
+    }
+    fprintf(out, "\n]\n");
+
+    if(out != stdout){
+        fclose(out);
+    }
+    return rc;
+}
@@ -0,0 +1,228 @@
+/*
+ * aesd-read-bench.c
+ *
+ * Concurrent read scaling of a loaded aesdchar device.  Reader threads each
+ * open the device and pread() its whole contents from offset 0 over and
+ * over, optionally while one writer keeps storing fixed size commands so
+ * entries are evicted under the readers.  Runs with 1, 2, 4 ... up to the
+ * requested readers, reporting reads and bytes per second and the speedup
+ * in bytes per second over a single reader; readers that don't share a
+ * lock scale with the number of CPUs.
+ *
+ * The device is filled with enough commands to be read before timing.
+ *
+ * Usage: aesd-read-bench [-f device] [-r max_readers] [-d seconds]
+ *                        [-s command_size] [-w]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+#define READ_BUFFER_SIZE (1 << 20)
+#define FILL_COMMANDS 128
+
+struct bench_config{
+    const char *device;
+    int max_readers;
+    double seconds;
+    size_t command_size;
+    bool writer;
+};
+
+struct bench_state{
+    const struct bench_config *config;
+    atomic_bool stop;
+    _Atomic uint64_t reads;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t writes;
+    atomic_int errors;
+};
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/* One command of size bytes ending in a newline */
+static char *make_command(size_t size){
+    char *command = malloc(size);
+
+    if(command != NULL){
+        memset(command, 'a', size - 1);
+        command[size - 1] = '\n';
+    }
+    return command;
+}
+
+static void *reader(void *arg){
+    struct bench_state *state = arg;
+    char *buf = malloc(READ_BUFFER_SIZE);
+    uint64_t reads = 0, bytes = 0;
+    ssize_t rc;
+    int fd;
+
+    fd = open(state->config->device, O_RDONLY);
+    if( (fd == -1) || (buf == NULL) ){
+        atomic_fetch_add(&state->errors, 1);
+        goto out;
+    }
+    while(!atomic_load_explicit(&state->stop, memory_order_relaxed)){
+        rc = pread(fd, buf, READ_BUFFER_SIZE, 0);
+        if(rc == -1){
+            atomic_fetch_add(&state->errors, 1);
+            break;
+        }
+        reads++;
+        bytes += rc;
+    }
+    atomic_fetch_add(&state->reads, reads);
+    atomic_fetch_add(&state->bytes, bytes);
+
+    out:
+    if(fd != -1){
+        close(fd);
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *writer(void *arg){
+    struct bench_state *state = arg;
+    char *command = make_command(state->config->command_size);
+    uint64_t writes = 0;
+    int fd;
+
+    fd = open(state->config->device, O_WRONLY);
+    if( (fd == -1) || (command == NULL) ){
+        atomic_fetch_add(&state->errors, 1);
+        goto out;
+    }
+    while(!atomic_load_explicit(&state->stop, memory_order_relaxed)){
+        if(write(fd, command, state->config->command_size) != (ssize_t)state->config->command_size){
+            atomic_fetch_add(&state->errors, 1);
+            break;
+        }
+        writes++;
+    }
+    atomic_fetch_add(&state->writes, writes);
+
+    out:
+    if(fd != -1){
+        close(fd);
+    }
+    free(command);
+    return NULL;
+}
+
+static int run(const struct bench_config *config, int readers, double *base){
+    struct bench_state state;
+    pthread_t threads[MAX_THREADS + 1];
+    int started = 0, i;
+    struct timespec pause;
+    double start, elapsed, bytes;
+
+    state.config = config;
+    atomic_init(&state.stop, false);
+    atomic_init(&state.reads, 0);
+    atomic_init(&state.bytes, 0);
+    atomic_init(&state.writes, 0);
+    atomic_init(&state.errors, 0);
+
+    start = now_s();
+    for(i = 0; i < readers; i++){
+        if(pthread_create(&threads[started], NULL, reader, &state) == 0){
+            started++;
+        }
+    }
+    if( config->writer && (pthread_create(&threads[started], NULL, writer, &state) == 0) ){
+        started++;
+    }
+
+    pause.tv_sec = (time_t)config->seconds;
+    pause.tv_nsec = (long)((config->seconds - pause.tv_sec) * 1e9);
+    nanosleep(&pause, NULL);
+    atomic_store(&state.stop, true);
+    for(i = 0; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = now_s() - start;
+
+    if( (started != readers + config->writer) || (atomic_load(&state.errors) != 0) ){
+        fprintf(stderr, "readers=%d: %d threads started, %d errors\n", readers, started, atomic_load(&state.errors));
+        return -1;
+    }
+    bytes = atomic_load(&state.bytes) / elapsed;
+    if(*base == 0){
+        *base = bytes;
+    }
+    printf("readers=%-3d reads=%.0f/s bytes=%.1f MB/s writes=%.0f/s speedup=%.2f\n", readers,
+            atomic_load(&state.reads) / elapsed, bytes / 1e6, atomic_load(&state.writes) / elapsed, bytes / *base);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    struct bench_config config = { .device = "/dev/aesdchar", .max_readers = 4, .seconds = 2.0,
+            .command_size = 64, .writer = false };
+    char *command;
+    double base = 0;
+    int opt, fd, i, readers, rc = 0;
+
+    while( (opt = getopt(argc, argv, "f:r:d:s:w")) != -1 ){
+        switch(opt){
+            case 'f': config.device = optarg; break;
+            case 'r': config.max_readers = atoi(optarg); break;
+            case 'd': config.seconds = atof(optarg); break;
+            case 's': config.command_size = strtoul(optarg, NULL, 0); break;
+            case 'w': config.writer = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-f device] [-r max_readers] [-d seconds] [-s command_size] [-w]\n", argv[0]);
+                return 1;
+        }
+    }
+    if( (config.max_readers < 1) || (config.max_readers > MAX_THREADS) || (config.seconds <= 0) ||
+            (config.command_size == 0) ){
+        fprintf(stderr, "Need 1 to %d readers, a positive duration and command size\n", MAX_THREADS);
+        return 1;
+    }
+
+    fd = open(config.device, O_WRONLY);
+    command = make_command(config.command_size);
+    if( (fd == -1) || (command == NULL) ){
+        perror(config.device);
+        free(command);
+        return 1;
+    }
+    for(i = 0; i < FILL_COMMANDS; i++){
+        if(write(fd, command, config.command_size) != (ssize_t)config.command_size){
+            perror("write");
+            rc = -1;
+            break;
+        }
+    }
+    close(fd);
+    free(command);
+
+    printf("device=%s seconds=%.1f command_size=%zu writer=%s\n", config.device, config.seconds,
+            config.command_size, config.writer ? "yes" : "no");
+    /* Doubling readers, the last round runs max_readers */
+    for(readers = 1; rc == 0; readers *= 2){
+        if(readers > config.max_readers){
+            readers = config.max_readers;
+        }
+        rc = run(&config, readers, &base);
+        if(readers == config.max_readers){
+            break;
+        }
+    }
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * aesd-ring-bench.cpp
+ *
+ * Compares the header-only aesd::ring against the C aesd_circular_buffer it
+ * mirrors, at the same capacities and entry sizes.  Both sides own copies of
+ * their payloads the way aesdsocket's ring backend does: the C buffer holds
+ * malloc'd copies and frees what add_entry_evict() displaces, the ring holds
+ * aesd::entry objects and drops what push() hands back.
+ *
+ * Cases, each reported as min/median nanoseconds per operation:
+ *   add       add to a full ring, overwriting the oldest entry
+ *   find      fpos lookups at random offsets over the stored bytes
+ *   iterate   walk every entry oldest to newest summing sizes
+ * The C add also stamps sequence numbers and timestamps, which the ring
+ * leaves to the entry type; the clock read is part of its cost.
+ * Before timing, find results of both are checked to agree on every offset.
+ *
+ * Usage: aesd-ring-bench [-n operations] [-r repetitions]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+#include "../aesd-char-driver/aesd-ring.hpp"
+
+extern "C" {
+#include "../aesd-char-driver/aesd-circular-buffer.h"
+}
+
+namespace {
+
+char payload[1024];
+volatile std::size_t sink;
+std::uint64_t rng_state = 88172645463325252ULL;
+
+std::uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+struct samples {
+    std::vector<double> ns;
+
+    void report(const char *op, const char *impl, std::size_t capacity)
+    {
+        std::sort(ns.begin(), ns.end());
+        std::printf("%-8s %-4s capacity=%-6zu min=%8.2f ns/op median=%8.2f ns/op\n",
+                    op, impl, capacity, ns.front(), ns[ns.size() / 2]);
+        ns.clear();
+    }
+};
+
+template <typename F>
+void time_ops(samples &s, int repetitions, std::size_t operations, F &&body)
+{
+    // One untimed round for warmup
+    for(int r = -1; r < repetitions; r++){
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if(r >= 0){
+            s.ns.push_back(elapsed.count() / operations);
+        }
+    }
+}
+
+// C buffer owning malloc'd copies, as in aesd-storage-ring.c
+void c_add(aesd_circular_buffer &buffer, std::size_t size)
+{
+    aesd_buffer_entry entry, evicted;
+    char *copy = static_cast<char *>(std::malloc(size));
+
+    std::memcpy(copy, payload, size);
+    entry.buffptr = copy;
+    entry.size = size;
+    evicted.buffptr = nullptr;
+    aesd_circular_buffer_add_entry_evict(&buffer, &entry, &evicted, 1);
+    std::free(const_cast<char *>(evicted.buffptr));
+}
+
+template <std::size_t Capacity>
+int bench(std::size_t operations, int repetitions)
+{
+    // Heap allocated, the larger rings would not fit on the stack
+    auto owner = std::make_unique<aesd::ring<aesd::entry, Capacity>>();
+    auto &ring = *owner;
+    std::vector<aesd_buffer_entry> storage(Capacity);
+    aesd_circular_buffer buffer;
+    std::vector<std::size_t> sizes(operations), offsets(operations);
+    aesd_buffer_entry *it;
+    std::uint32_t index;
+    samples s;
+    int rc = 0;
+
+    aesd_circular_buffer_init_capacity(&buffer, storage.data(), Capacity);
+    for(auto &size : sizes){
+        size = 1 + (rng_next() % sizeof(payload));
+    }
+    for(std::size_t i = 0; i < 2 * Capacity; i++){
+        c_add(buffer, sizes[i % operations]);
+        ring.emplace(payload, sizes[i % operations]);
+    }
+
+    time_ops(s, repetitions, operations, [&] {
+        for(std::size_t i = 0; i < operations; i++){
+            c_add(buffer, sizes[i]);
+        }
+    });
+    s.report("add", "c", Capacity);
+    time_ops(s, repetitions, operations, [&] {
+        for(std::size_t i = 0; i < operations; i++){
+            ring.emplace(payload, sizes[i]);
+        }
+    });
+    s.report("add", "c++", Capacity);
+
+    for(auto &offset : offsets){
+        offset = rng_next() % ring.bytes();
+    }
+    for(auto offset : offsets){
+        std::size_t entry_offset;
+        aesd_buffer_entry *entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, offset, &entry_offset);
+        auto pos = ring.locate(offset);
+        if( (entry == nullptr) || !pos || (pos->offset != entry_offset) ||
+                (pos->entry->size() != entry->size) ){
+            std::fprintf(stderr, "find mismatch at fpos %zu\n", offset);
+            rc = -1;
+            break;
+        }
+    }
+
+    time_ops(s, repetitions, operations, [&] {
+        for(auto offset : offsets){
+            std::size_t entry_offset;
+            aesd_buffer_entry *entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, offset, &entry_offset);
+            sink += entry_offset + (entry != nullptr);
+        }
+    });
+    s.report("find", "c", Capacity);
+    time_ops(s, repetitions, operations, [&] {
+        for(auto offset : offsets){
+            sink += ring.find(offset).size();
+        }
+    });
+    s.report("find", "c++", Capacity);
+
+    time_ops(s, repetitions, Capacity, [&] {
+        std::size_t total = 0;
+        AESD_CIRCULAR_BUFFER_FOREACH(it, &buffer, index){
+            total += it->size;
+        }
+        sink += total;
+    });
+    s.report("iterate", "c", Capacity);
+    time_ops(s, repetitions, Capacity, [&] {
+        std::size_t total = 0;
+        for(const auto &entry : ring){
+            total += entry.size();
+        }
+        sink += total;
+    });
+    s.report("iterate", "c++", Capacity);
+
+    AESD_CIRCULAR_BUFFER_FOREACH(it, &buffer, index){
+        std::free(const_cast<char *>(it->buffptr));
+    }
+    return rc;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t operations = 1 << 18;
+    int repetitions = 5, opt;
+
+    while( (opt = getopt(argc, argv, "n:r:")) != -1 ){
+        switch(opt){
+            case 'n': operations = std::strtoul(optarg, nullptr, 0); break;
+            case 'r': repetitions = std::atoi(optarg); break;
+            default:
+                std::fprintf(stderr, "Usage: %s [-n operations] [-r repetitions]\n", argv[0]);
+                return 1;
+        }
+    }
+    if( (operations == 0) || (repetitions < 1) ){
+        std::fprintf(stderr, "Need at least one operation and repetition\n");
+        return 1;
+    }
+
+    if( (bench<16>(operations, repetitions) == -1) || (bench<1024>(operations, repetitions) == -1) ||
+            (bench<65536>(operations, repetitions) == -1) ){
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * aesd-lz-bench.c
+ *
+ * Throughput of the aesd-lz block codec on data shaped like the aesdsocket
+ * log (timestamp lines mixed with client packets) and on incompressible
+ * random data.  The per-block decompression time is the latency a reply pays
+ * before the first byte of a sealed block can be sent by the lz storage.
+ *
+ * Usage: aesd-lz-bench [-b block_size] [-m total_megabytes] [-r repetitions]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "aesd-lz.h"
+
+static double now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// Function to fill buf with lines resembling the stored socket log
+static void fill_log(char *buf, size_t len){
+    static const char *days[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+    size_t pos = 0;
+    unsigned int t = 0;
+    char line[128];
+
+    while(pos < len){
+        int n;
+        if(t % 4 == 0){
+            n = snprintf(line, sizeof(line), "timestamp:%s, %02u Mar 2026 %02u:%02u:%02u +0000\n",
+                    days[(t / 8640) % 7], 1 + (t / 86400) % 28, (t / 3600) % 24, (t / 60) % 60, t % 60);
+        }else{
+            n = snprintf(line, sizeof(line), "sensor %u reading %u status ok\n", t % 17, (t * 7919) % 1000);
+        }
+        if((size_t)n > len - pos){
+            n = len - pos;
+        }
+        memcpy(buf + pos, line, n);
+        pos += n;
+        t += 3;
+    }
+}
+
+static void fill_random(char *buf, size_t len){
+    unsigned int x = 2463534242U;
+
+    for(size_t i = 0; i < len; i++){
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        buf[i] = (char)x;
+    }
+}
+
+static int run(const char *name, const char *data, size_t total, size_t block, int reps){
+    size_t blocks = total / block;
+    char *out = malloc(AESD_LZ_BOUND(block));
+    char *back = malloc(block);
+    size_t compressed = 0;
+    double best_c = 0, best_d = 0;
+
+    if( (out == NULL) || (back == NULL) ){
+        perror("malloc");
+        return -1;
+    }
+
+    for(int r = 0; r < reps; r++){
+        double c_us = 0, d_us = 0;
+        compressed = 0;
+
+        for(size_t b = 0; b < blocks; b++){
+            const char *src = data + (b * block);
+            double t0 = now_us();
+            size_t clen = aesd_lz_compress(src, block, out, AESD_LZ_BOUND(block));
+            double t1 = now_us();
+            ssize_t dlen = aesd_lz_decompress(out, clen, back, block);
+            double t2 = now_us();
+
+            if( (clen == 0) || (dlen != (ssize_t)block) || (memcmp(src, back, block) != 0) ){
+                fprintf(stderr, "%s: round trip mismatch in block %zu\n", name, b);
+                free(out);
+                free(back);
+                return -1;
+            }
+            compressed += clen;
+            c_us += t1 - t0;
+            d_us += t2 - t1;
+        }
+
+        // Report the best repetition, first one doubles as warmup
+        if( (r == 0) || (c_us < best_c) ){
+            best_c = c_us;
+        }
+        if( (r == 0) || (d_us < best_d) ){
+            best_d = d_us;
+        }
+    }
+
+    printf("%-7s ratio=%.2fx compress=%.1fMB/s decompress=%.1fMB/s block_decompress=%.1fus\n",
+            name, (double)(blocks * block) / compressed,
+            (blocks * block) / best_c, (blocks * block) / best_d, best_d / blocks);
+
+    free(out);
+    free(back);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    size_t block = 64 * 1024;
+    size_t total = 64 * 1024 * 1024;
+    int reps = 5;
+    int opt, rc = 0;
+    char *data;
+
+    while( (opt = getopt(argc, argv, "b:m:r:")) != -1 ){
+        switch(opt){
+            case 'b': block = strtoul(optarg, NULL, 0); break;
+            case 'm': total = strtoul(optarg, NULL, 0) * 1024 * 1024; break;
+            case 'r': reps = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-b block_size] [-m total_megabytes] [-r repetitions]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if( (block == 0) || (total < block) || (reps < 1) ){
+        fprintf(stderr, "Need a non-zero block no larger than the total and at least one repetition\n");
+        return 1;
+    }
+
+    if( (data = malloc(total)) == NULL ){
+        perror("malloc");
+        return 1;
+    }
+
+    printf("block=%zu total=%zuMB repetitions=%d\n", block, total / (1024 * 1024), reps);
+    fill_log(data, total);
+    rc |= run("log", data, total, block, reps);
+    fill_random(data, total);
+    rc |= run("random", data, total, block, reps);
+
+    free(data);
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file aesd-lz.c
+ * @brief Greedy single-pass LZ77 compressor and bounds checked decompressor
+ *
+ * See aesd-lz.h for the block format.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "aesd-lz.h"
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   65535
+#define LZ_HASH_LOG     12
+
+static inline uint32_t read32(const char *p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t seq){
+    return (seq * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+// Function to write a length extension (255 runs), returns new output position or NULL if full
+static char *write_length(char *op, const char *oend, size_t len){
+    while(len >= 255){
+        if(op >= oend){
+            return NULL;
+        }
+        *op++ = (char)255;
+        len -= 255;
+    }
+    if(op >= oend){
+        return NULL;
+    }
+    *op++ = (char)len;
+    return op;
+}
+
+// Function to emit one sequence, match_len 0 marks the final literal-only sequence
+static char *write_sequence(char *op, const char *oend, const char *literals, size_t lit_len,
+                            size_t offset, size_t match_len){
+    size_t ml = match_len ? (match_len - LZ_MIN_MATCH) : 0;
+    char *token = op++;
+
+    if(token >= oend){
+        return NULL;
+    }
+    *token = (char)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+
+    if( (lit_len >= 15) && ((op = write_length(op, oend, lit_len - 15)) == NULL) ){
+        return NULL;
+    }
+    if((size_t)(oend - op) < lit_len){
+        return NULL;
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+
+    if(match_len == 0){
+        return op;
+    }
+
+    if(oend - op < 2){
+        return NULL;
+    }
+    *op++ = (char)(offset & 0xff);
+    *op++ = (char)(offset >> 8);
+
+    if(ml >= 15){
+        op = write_length(op, oend, ml - 15);
+    }
+    return op;
+}
+
+size_t aesd_lz_compress(const char *src, size_t src_len, char *dst, size_t dst_cap){
+    uint32_t table[1 << LZ_HASH_LOG];
+    const char *ip = src;
+    const char *anchor = src;
+    const char *iend = src + src_len;
+    char *op = dst;
+    const char *oend = dst + dst_cap;
+
+    memset(table, 0, sizeof(table));
+
+    while( (iend - ip) >= LZ_MIN_MATCH ){
+        uint32_t seq = read32(ip);
+        uint32_t h = lz_hash(seq);
+        const char *ref = src + table[h];
+
+        table[h] = (uint32_t)(ip - src);
+
+        if( (ref < ip) && ((ip - ref) <= LZ_MAX_OFFSET) && (read32(ref) == seq) ){
+            size_t match_len = LZ_MIN_MATCH;
+
+            while( (ip + match_len < iend) && (ref[match_len] == ip[match_len]) ){
+                match_len++;
+            }
+
+            op = write_sequence(op, oend, anchor, ip - anchor, ip - ref, match_len);
+            if(op == NULL){
+                return 0;
+            }
+            ip += match_len;
+            anchor = ip;
+        }else{
+            ip++;
+        }
+    }
+
+    op = write_sequence(op, oend, anchor, iend - anchor, 0, 0);
+    return (op == NULL) ? 0 : (size_t)(op - dst);
+}
+
+// Function to read a length extension, returns 0 on success or -1 if input ends
+static int read_length(const unsigned char **ip, const unsigned char *iend, size_t *len){
+    unsigned char b;
+
+    do{
+        if(*ip >= iend){
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    }while(b == 255);
+    return 0;
+}
+
+ssize_t aesd_lz_decompress(const char *src, size_t src_len, char *dst, size_t dst_cap){
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + src_len;
+    char *op = dst;
+    char *oend = dst + dst_cap;
+
+    while(ip < iend){
+        unsigned char token = *ip++;
+        size_t lit_len = token >> 4;
+        size_t match_len = token & 0x0f;
+        size_t offset;
+        const char *ref;
+
+        if( (lit_len == 15) && (read_length(&ip, iend, &lit_len) == -1) ){
+            return -1;
+        }
+        if( ((size_t)(iend - ip) < lit_len) || ((size_t)(oend - op) < lit_len) ){
+            return -1;
+        }
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // Final sequence has literals only
+        if(ip == iend){
+            break;
+        }
+
+        if(iend - ip < 2){
+            return -1;
+        }
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if( (match_len == 15) && (read_length(&ip, iend, &match_len) == -1) ){
+            return -1;
+        }
+        match_len += LZ_MIN_MATCH;
+
+        if( (offset == 0) || (offset > (size_t)(op - dst)) || ((size_t)(oend - op) < match_len) ){
+            return -1;
+        }
+
+        // Byte copy only for overlapping matches (offset < match_len), they replicate a short run
+        ref = op - offset;
+        if(offset >= match_len){
+            memcpy(op, ref, match_len);
+            op += match_len;
+        }else{
+            while(match_len--){
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op - dst;
+}
@@ -0,0 +1,37 @@
+/*
+ * aesd-lz.h
+ *
+ *  @brief Self-contained LZ77 block codec in the style of the LZ4 block format
+ *
+ *  Each compressed block is a series of sequences: a token byte holding the
+ *  literal count (high nibble) and match length - 4 (low nibble), optional
+ *  255-run length extension bytes, the literals, then a little endian 16 bit
+ *  match offset and optional match length extension bytes.  The last sequence
+ *  of a block carries literals only.  Blocks don't reference each other so
+ *  any block can be decompressed on its own.
+ */
+
+#ifndef AESD_LZ_H
+#define AESD_LZ_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Worst case compressed size for len bytes of input
+ */
+#define AESD_LZ_BOUND(len) ((len) + ((len) / 255) + 16)
+
+/**
+ * Compress src_len bytes of src into dst.
+ * @return compressed size, or 0 if the result would not fit in dst_cap bytes
+ */
+size_t aesd_lz_compress(const char *src, size_t src_len, char *dst, size_t dst_cap);
+
+/**
+ * Decompress a block produced by aesd_lz_compress into dst.
+ * @return decompressed size, or -1 if the block is corrupt or larger than dst_cap
+ */
+ssize_t aesd_lz_decompress(const char *src, size_t src_len, char *dst, size_t dst_cap);
+
+#endif /* AESD_LZ_H */
@@ -0,0 +1,168 @@
+/**
+ * @file aesd-storage-fd.c
+ * @brief aesdsocket storage backends writing straight to a file descriptor
+ *
+ * The device backend uses /dev/aesdchar, which keeps its own bounded history
+ * and implements AESDCHAR_IOCSEEKTO.  The file backend appends to a log file
+ * that is removed when the server shuts down.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include "aesd-storage.h"
+
+#define AESD_DEVICE_PATH "/dev/aesdchar"
+#define AESD_FILE_PATH "/var/tmp/aesdsocketdata"
+// Bytes per sendfile() call, below its 0x7ffff000 limit
+#define AESD_SENDFILE_CHUNK (1 << 30)
+
+struct fd_handle{
+    int fd;
+};
+
+static void *fd_open(const char *path, int flags){
+    struct fd_handle *h = malloc(sizeof(struct fd_handle));
+
+    if(h == NULL){
+        return NULL;
+    }
+    if( (h->fd = open(path, flags, 0644)) == -1 ){
+        int err = errno;
+        free(h);
+        errno = err;
+        return NULL;
+    }
+    return h;
+}
+
+static void *device_open(void){
+    return fd_open(AESD_DEVICE_PATH, O_RDWR);
+}
+
+static void *file_open(void){
+    return fd_open(AESD_FILE_PATH, O_RDWR | O_CREAT | O_APPEND);
+}
+
+static void fd_close(void *handle){
+    struct fd_handle *h = handle;
+
+    close(h->fd);
+    free(h);
+}
+
+static int fd_init(const struct aesd_storage_config *config){
+    return 0;
+}
+
+static void device_cleanup(void){
+}
+
+static void file_cleanup(void){
+    int err;
+
+    // Delete the output file
+    if(unlink(AESD_FILE_PATH) == -1){
+        err = errno;
+        if(err != ENOENT){  // Ignore error if file doesn't exist
+            syslog(LOG_ERR, "Failed to delete output file: %s\n", strerror(err));
+        }
+    }
+}
+
+static int fd_append(void *handle, const char *buf, size_t len){
+    struct fd_handle *h = handle;
+    size_t written = 0;
+
+    while(written < len){
+        ssize_t result = write(h->fd, buf + written, len - written);
+        if(result == -1){
+            return -1;
+        }
+        written += result;
+    }
+    return 0;
+}
+
+static int fd_seekto(void *handle, const struct aesd_seekto *seekto, uint64_t *offset){
+    struct fd_handle *h = handle;
+    struct aesd_seekto request = *seekto;
+    off_t pos;
+
+    // The driver moves the file position, read it back as the absolute offset
+    if( (ioctl(h->fd, AESDCHAR_IOCSEEKTO, &request) < 0) || ((pos = lseek(h->fd, 0, SEEK_CUR)) == -1) ){
+        return -1;
+    }
+    *offset = pos;
+    return 0;
+}
+
+static off_t fd_size(void *handle){
+    struct fd_handle *h = handle;
+    off_t cur, end;
+
+    if( (cur = lseek(h->fd, 0, SEEK_CUR)) == -1 ){
+        return -1;
+    }
+    end = lseek(h->fd, 0, SEEK_END);
+    if(lseek(h->fd, cur, SEEK_SET) == -1){
+        return -1;
+    }
+    return end;
+}
+
+static ssize_t fd_read(void *handle, char *buf, size_t len, uint64_t offset){
+    struct fd_handle *h = handle;
+
+    return pread(h->fd, buf, len, offset);
+}
+
+static int fd_send(void *handle, int client_fd, uint64_t offset){
+    struct fd_handle *h = handle;
+    off_t pos = offset;
+    ssize_t sent;
+
+    // Advances pos, returns 0 once it reaches the end of the stored bytes
+    while( (sent = sendfile(client_fd, h->fd, &pos, AESD_SENDFILE_CHUNK)) != 0 ){
+        if(sent == -1){
+            // Drivers built without splice_read, let the caller read() instead
+            if( (pos == (off_t)offset) && ((errno == EINVAL) || (errno == ENOSYS)) ){
+                errno = EOPNOTSUPP;
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const struct aesd_storage_ops aesd_storage_device_ops = {
+    .name =     "device",
+    .init =     fd_init,
+    .cleanup =  device_cleanup,
+    .open =     device_open,
+    .close =    fd_close,
+    .append =   fd_append,
+    .seekto =   fd_seekto,
+    .size =     fd_size,
+    .read =     fd_read,
+    .send =     fd_send,
+};
+
+const struct aesd_storage_ops aesd_storage_file_ops = {
+    .name =     "file",
+    .init =     fd_init,
+    .cleanup =  file_cleanup,
+    .open =     file_open,
+    .close =    fd_close,
+    .append =   fd_append,
+    .seekto =   fd_seekto,
+    .size =     fd_size,
+    .read =     fd_read,
+    .send =     fd_send,
+};
@@ -0,0 +1,260 @@
+/**
+ * @file aesd-storage-lz.c
+ * @brief aesdsocket storage backend keeping the log as compressed fixed-size blocks
+ *
+ * Received bytes collect in an uncompressed tail block in memory.  Once the
+ * tail holds LZ_BLOCK_SIZE bytes it is compressed with aesd-lz and appended
+ * to the log file behind a small header, falling back to raw storage when a
+ * block doesn't shrink.  Every sealed block covers exactly LZ_BLOCK_SIZE
+ * bytes of the logical stream, so the in-memory index maps any offset to its
+ * block in O(1) and replies decompress one block at a time.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include "aesd-lz.h"
+#include "aesd-storage.h"
+
+#define AESD_LZ_PATH "/var/tmp/aesdsocketdata.lz"
+#define LZ_BLOCK_SIZE (64 * 1024)
+
+/* On-disk header in front of each sealed block */
+struct lz_block_header{
+    uint32_t raw_len;
+    /* Equal to raw_len when the block is stored uncompressed */
+    uint32_t stored_len;
+};
+
+struct lz_block{
+    /* Offset of the block payload (after its header) in the log file */
+    off_t file_offset;
+    uint32_t stored_len;
+};
+
+/* Shared backend state, protected by aesdsocket's file_mutex */
+static struct{
+    int fd;
+    off_t file_size;
+    struct lz_block *index;
+    size_t nr_blocks;
+    size_t index_cap;
+    char *tail;
+    size_t tail_len;
+    char *scratch;
+} lz = { .fd = -1 };
+
+/* Per-client decompression cache so sequential replies decompress each block once */
+struct lz_handle{
+    size_t cached_block;
+    int cache_valid;
+    char *stored;
+    char *cache;
+};
+
+static void lz_cleanup(void){
+    int err;
+
+    if(lz.fd != -1){
+        close(lz.fd);
+        lz.fd = -1;
+    }
+    if(unlink(AESD_LZ_PATH) == -1){
+        err = errno;
+        if(err != ENOENT){  // Ignore error if file doesn't exist
+            syslog(LOG_ERR, "Failed to delete compressed output file: %s\n", strerror(err));
+        }
+    }
+
+    free(lz.index);
+    free(lz.tail);
+    free(lz.scratch);
+    lz.index = NULL;
+    lz.tail = NULL;
+    lz.scratch = NULL;
+    lz.nr_blocks = lz.index_cap = lz.tail_len = 0;
+    lz.file_size = 0;
+}
+
+static int lz_init(const struct aesd_storage_config *config){
+    // Block index lives in memory, start from an empty log
+    lz.fd = open(AESD_LZ_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    lz.tail = malloc(LZ_BLOCK_SIZE);
+    lz.scratch = malloc(AESD_LZ_BOUND(LZ_BLOCK_SIZE));
+
+    if( (lz.fd == -1) || (lz.tail == NULL) || (lz.scratch == NULL) ){
+        int err = (lz.fd == -1) ? errno : ENOMEM;
+        lz_cleanup();
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+static void *lz_open(void){
+    struct lz_handle *h = calloc(1, sizeof(struct lz_handle));
+
+    if(h == NULL){
+        return NULL;
+    }
+    h->stored = malloc(LZ_BLOCK_SIZE);
+    h->cache = malloc(LZ_BLOCK_SIZE);
+    if( (h->stored == NULL) || (h->cache == NULL) ){
+        free(h->stored);
+        free(h->cache);
+        free(h);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return h;
+}
+
+static void lz_close(void *handle){
+    struct lz_handle *h = handle;
+
+    free(h->stored);
+    free(h->cache);
+    free(h);
+}
+
+// Function to compress the full tail block and append it to the log file
+static int lz_seal_tail(void){
+    struct lz_block_header header;
+    struct lz_block *block;
+    const char *payload = lz.scratch;
+    size_t stored_len;
+
+    if(lz.nr_blocks == lz.index_cap){
+        size_t cap = lz.index_cap ? (lz.index_cap * 2) : 64;
+        struct lz_block *tmp = realloc(lz.index, cap * sizeof(struct lz_block));
+        if(tmp == NULL){
+            errno = ENOMEM;
+            return -1;
+        }
+        lz.index = tmp;
+        lz.index_cap = cap;
+    }
+
+    // Keep incompressible blocks raw so they never grow
+    stored_len = aesd_lz_compress(lz.tail, LZ_BLOCK_SIZE, lz.scratch, LZ_BLOCK_SIZE - 1);
+    if(stored_len == 0){
+        stored_len = LZ_BLOCK_SIZE;
+        payload = lz.tail;
+    }
+
+    header.raw_len = LZ_BLOCK_SIZE;
+    header.stored_len = stored_len;
+    if( (pwrite(lz.fd, &header, sizeof(header), lz.file_size) != sizeof(header)) ||
+            (pwrite(lz.fd, payload, stored_len, lz.file_size + sizeof(header)) != (ssize_t)stored_len) ){
+        syslog(LOG_ERR, "Writing compressed block failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    block = &lz.index[lz.nr_blocks++];
+    block->file_offset = lz.file_size + sizeof(header);
+    block->stored_len = stored_len;
+    lz.file_size += sizeof(header) + stored_len;
+    lz.tail_len = 0;
+    return 0;
+}
+
+static int lz_append(void *handle, const char *buf, size_t len){
+    while(len > 0){
+        size_t chunk = LZ_BLOCK_SIZE - lz.tail_len;
+
+        if(chunk > len){
+            chunk = len;
+        }
+        memcpy(lz.tail + lz.tail_len, buf, chunk);
+        lz.tail_len += chunk;
+        buf += chunk;
+        len -= chunk;
+
+        if( (lz.tail_len == LZ_BLOCK_SIZE) && (lz_seal_tail() == -1) ){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int lz_seekto(void *handle, const struct aesd_seekto *seekto, uint64_t *offset){
+    // Commands are only tracked by the aesdchar driver
+    errno = ENOTTY;
+    return -1;
+}
+
+static off_t lz_size(void *handle){
+    return ((off_t)lz.nr_blocks * LZ_BLOCK_SIZE) + lz.tail_len;
+}
+
+// Function to make block_nr the cached decompressed block of handle
+static int lz_load_block(struct lz_handle *h, size_t block_nr){
+    const struct lz_block *block = &lz.index[block_nr];
+
+    if(h->cache_valid && (h->cached_block == block_nr)){
+        return 0;
+    }
+
+    if(pread(lz.fd, h->stored, block->stored_len, block->file_offset) != (ssize_t)block->stored_len){
+        errno = EIO;
+        return -1;
+    }
+
+    if(block->stored_len == LZ_BLOCK_SIZE){
+        memcpy(h->cache, h->stored, LZ_BLOCK_SIZE);
+    }else if(aesd_lz_decompress(h->stored, block->stored_len, h->cache, LZ_BLOCK_SIZE) != LZ_BLOCK_SIZE){
+        syslog(LOG_ERR, "Compressed block %zu is corrupt\n", block_nr);
+        errno = EIO;
+        return -1;
+    }
+
+    h->cached_block = block_nr;
+    h->cache_valid = 1;
+    return 0;
+}
+
+static ssize_t lz_read(void *handle, char *buf, size_t len, uint64_t offset){
+    struct lz_handle *h = handle;
+    size_t block_nr = offset / LZ_BLOCK_SIZE;
+    size_t block_offset = offset % LZ_BLOCK_SIZE;
+    const char *src;
+    size_t avail;
+
+    if(offset >= (uint64_t)lz_size(handle)){
+        return 0;
+    }
+
+    // Offsets past the sealed blocks fall into the uncompressed tail
+    if(block_nr == lz.nr_blocks){
+        src = lz.tail;
+        avail = lz.tail_len - block_offset;
+    }else{
+        if(lz_load_block(h, block_nr) == -1){
+            return -1;
+        }
+        src = h->cache;
+        avail = LZ_BLOCK_SIZE - block_offset;
+    }
+
+    if(len > avail){
+        len = avail;
+    }
+    memcpy(buf, src + block_offset, len);
+    return len;
+}
+
+const struct aesd_storage_ops aesd_storage_lz_ops = {
+    .name =     "lz",
+    .init =     lz_init,
+    .cleanup =  lz_cleanup,
+    .open =     lz_open,
+    .close =    lz_close,
+    .append =   lz_append,
+    .seekto =   lz_seekto,
+    .size =     lz_size,
+    .read =     lz_read,
+};
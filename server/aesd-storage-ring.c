@@ -0,0 +1,322 @@
+/**
+ * @file aesd-storage-ring.c
+ * @brief aesdsocket storage backend running the aesdchar circular buffer in process
+ *
+ * Mirrors aesd_write/aesd_read/AESDCHAR_IOCSEEKTO of the driver for hosts
+ * where the module can't be loaded: writes accumulate in a working entry
+ * until a newline completes it, completed entries go into the
+ * aesd_circular_buffer and the oldest ones are freed when they are evicted,
+ * by entry count or by the -b byte budget.
+ * Replies are sent with writev straight from the entry buffers.
+ *
+ * With -r the entries survive restarts: cleanup writes them to a snapshot
+ * file (see struct aesd_snapshot_header) and init maps that file and restores
+ * all entries in one aesd_circular_buffer_restore() call.  Restored entries
+ * point into the mapping, it is unmapped once the last of them is evicted.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "aesd-storage.h"
+#include "../aesd-char-driver/aesd-circular-buffer.h"
+
+/* Entries handed to a single writev() call */
+#define RING_IOV_BATCH 64
+/* Entries released per eviction round */
+#define RING_EVICT_BATCH 16
+/* First allocation of the working entry, doubled as it fills */
+#define RING_ENTRY_MIN_CAPACITY 256
+
+/* The one history every client appends to and reads from */
+static struct{
+    struct aesd_circular_buffer buffer;
+    /* Entry storage for a configured capacity, NULL with the default one */
+    struct aesd_buffer_entry *history;
+    /* Entry to buffer data before placing it into circular buffer, and bytes allocated for it */
+    struct aesd_buffer_entry entry;
+    size_t entry_capacity;
+    /* Snapshot file given with -r, NULL without one */
+    const char *snapshot_path;
+    /* Mapping of the restored snapshot and the number of restored entries still pointing into it */
+    char *snapshot;
+    size_t snapshot_len;
+    size_t snapshot_entries;
+} ring;
+
+// Function to release an entry payload, malloc'd unless it was restored from the snapshot mapping
+static void ring_release(const char *buffptr){
+    if( (ring.snapshot != NULL) && (buffptr >= ring.snapshot) && (buffptr < ring.snapshot + ring.snapshot_len) ){
+        if(--ring.snapshot_entries == 0){
+            munmap(ring.snapshot, ring.snapshot_len);
+            ring.snapshot = NULL;
+        }
+        return;
+    }
+    free((void *)buffptr);
+}
+
+// Function to restore the buffer from the snapshot file, a missing or invalid file leaves it empty
+static void ring_restore(void){
+    struct stat st;
+    int fd, err;
+    void *image;
+
+    if( (fd = open(ring.snapshot_path, O_RDONLY)) == -1 ){
+        if(errno != ENOENT){
+            err = errno;
+            syslog(LOG_ERR, "Opening snapshot %s failed: %s\n", ring.snapshot_path, strerror(err));
+        }
+        return;
+    }
+    if( (fstat(fd, &st) == -1) || (st.st_size == 0) ){
+        close(fd);
+        return;
+    }
+
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    err = errno;
+    close(fd);
+    if(image == MAP_FAILED){
+        syslog(LOG_ERR, "Mapping snapshot %s failed: %s\n", ring.snapshot_path, strerror(err));
+        return;
+    }
+    if(!aesd_circular_buffer_restore(&ring.buffer, image, st.st_size)){
+        syslog(LOG_ERR, "Snapshot %s is invalid, starting empty\n", ring.snapshot_path);
+        munmap(image, st.st_size);
+        return;
+    }
+
+    ring.snapshot_entries = aesd_circular_buffer_entry_count(&ring.buffer);
+    if(ring.snapshot_entries == 0){
+        munmap(image, st.st_size);
+        return;
+    }
+    ring.snapshot = image;
+    ring.snapshot_len = st.st_size;
+    syslog(LOG_DEBUG, "Restored %zu entries from snapshot %s", ring.snapshot_entries, ring.snapshot_path);
+}
+
+// Function to write header, entry table and payloads to the file descriptor, returns 0 or -1 with errno set
+static int ring_write_snapshot(int fd){
+    struct aesd_snapshot_header header;
+    struct aesd_snapshot_entry *table;
+    struct iovec iov[RING_IOV_BATCH];
+    size_t count, nr_iov, bytes, offset = 0;
+    int rc;
+
+    count = aesd_circular_buffer_entry_count(&ring.buffer);
+    if( (table = malloc((count ? count : 1) * sizeof(struct aesd_snapshot_entry))) == NULL ){
+        errno = ENOMEM;
+        return -1;
+    }
+    count = aesd_circular_buffer_snapshot(&ring.buffer, &header, table, count);
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = table;
+    iov[1].iov_len = count * sizeof(struct aesd_snapshot_entry);
+    rc = aesd_storage_writev_all(fd, iov, 2);
+    free(table);
+
+    while( (rc == 0) &&
+            ((nr_iov = aesd_circular_buffer_fill_iovec(&ring.buffer, offset, SIZE_MAX, iov, RING_IOV_BATCH, &bytes)) > 0) ){
+        rc = aesd_storage_writev_all(fd, iov, nr_iov);
+        offset += bytes;
+    }
+    return rc;
+}
+
+// Function to save the buffer to the snapshot file, replaced atomically so a crash keeps the previous one
+static void ring_save(void){
+    char *tmp_path;
+    int fd, err;
+
+    if( (tmp_path = malloc(strlen(ring.snapshot_path) + sizeof(".tmp"))) == NULL ){
+        syslog(LOG_ERR, "Memory allocation failed: %s\n", strerror(ENOMEM));
+        return;
+    }
+    sprintf(tmp_path, "%s.tmp", ring.snapshot_path);
+
+    if( (fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1 ){
+        err = errno;
+        syslog(LOG_ERR, "Creating snapshot %s failed: %s\n", tmp_path, strerror(err));
+        free(tmp_path);
+        return;
+    }
+    if( (ring_write_snapshot(fd) == -1) || (fsync(fd) == -1) ){
+        err = errno;
+        syslog(LOG_ERR, "Writing snapshot %s failed: %s\n", tmp_path, strerror(err));
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        return;
+    }
+    close(fd);
+
+    // The old snapshot may still be mapped, rename leaves its pages intact
+    if(rename(tmp_path, ring.snapshot_path) == -1){
+        err = errno;
+        syslog(LOG_ERR, "Replacing snapshot %s failed: %s\n", ring.snapshot_path, strerror(err));
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+}
+
+static int ring_init(const struct aesd_storage_config *config){
+    memset(&ring.entry, 0, sizeof(struct aesd_buffer_entry));
+    ring.entry_capacity = 0;
+    ring.history = NULL;
+    ring.snapshot_path = config->snapshot_path;
+    ring.snapshot = NULL;
+    if(config->ring_entries == 0){
+        aesd_circular_buffer_init(&ring.buffer);
+    }else{
+        if( (ring.history = malloc((size_t)config->ring_entries * sizeof(struct aesd_buffer_entry))) == NULL ){
+            errno = ENOMEM;
+            return -1;
+        }
+        if(!aesd_circular_buffer_init_capacity(&ring.buffer, ring.history, config->ring_entries)){
+            free(ring.history);
+            ring.history = NULL;
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    aesd_circular_buffer_set_limits(&ring.buffer, config->max_bytes, 0);
+
+    if(ring.snapshot_path != NULL){
+        ring_restore();
+    }
+    return 0;
+}
+
+static void ring_cleanup(void){
+    uint32_t index;
+    struct aesd_buffer_entry *entry;
+
+    if(ring.snapshot_path != NULL){
+        ring_save();
+    }
+    free((void *)ring.entry.buffptr);
+    AESD_CIRCULAR_BUFFER_FOREACH(entry, &ring.buffer, index){
+        if(entry->buffptr != NULL){
+            ring_release(entry->buffptr);
+        }
+    }
+    free(ring.history);
+    ring.history = NULL;
+    aesd_circular_buffer_init(&ring.buffer);
+    memset(&ring.entry, 0, sizeof(struct aesd_buffer_entry));
+    ring.entry_capacity = 0;
+}
+
+static int ring_append(void *handle, const char *buf, size_t len){
+    size_t current_size = ring.entry.size;
+    char *tmp = (char *)ring.entry.buffptr;
+
+    // Double the working entry when it is full, so a command arriving in many chunks is copied O(1) times per byte
+    if(len > ring.entry_capacity - current_size){
+        size_t capacity = (ring.entry_capacity > 0) ? 2 * ring.entry_capacity : RING_ENTRY_MIN_CAPACITY;
+        if(capacity < current_size + len){
+            capacity = current_size + len;
+        }
+        if( (tmp = realloc(tmp, capacity)) == NULL ){
+            errno = ENOMEM;
+            return -1;
+        }
+        ring.entry.buffptr = tmp;
+        ring.entry_capacity = capacity;
+    }
+    memcpy(tmp + current_size, buf, len);
+    ring.entry.size = current_size + len;
+
+    // Only the newly added bytes can complete the entry
+    if(memchr(tmp + current_size, '\n', len) != NULL){
+        struct aesd_buffer_entry evicted[RING_EVICT_BATCH];
+        size_t nr_evicted, i;
+
+        // Stored entries don't keep the slack, shrinking in place normally doesn't copy
+        if( (ring.entry.size < ring.entry_capacity) && ((tmp = realloc(tmp, ring.entry.size)) != NULL) ){
+            ring.entry.buffptr = tmp;
+        }
+
+        // Oldest entries make room by count and byte budget, release them
+        nr_evicted = aesd_circular_buffer_add_entry_evict(&ring.buffer, &ring.entry, evicted, RING_EVICT_BATCH);
+        while(nr_evicted > 0){
+            for(i = 0; i < nr_evicted; i++){
+                ring_release(evicted[i].buffptr);
+            }
+            nr_evicted = (nr_evicted == RING_EVICT_BATCH) ?
+                    aesd_circular_buffer_evict(&ring.buffer, evicted, RING_EVICT_BATCH) : 0;
+        }
+        ring.entry.buffptr = NULL;
+        ring.entry.size = 0;
+        ring.entry_capacity = 0;
+    }
+    return 0;
+}
+
+static int ring_seekto(void *handle, const struct aesd_seekto *seekto, uint64_t *offset){
+    size_t fpos;
+
+    // Same bounds checks as aesd_adjust_file_offset in the driver
+    if(!aesd_circular_buffer_fpos_for_entry(&ring.buffer, seekto->write_cmd, seekto->write_cmd_offset, &fpos)){
+        errno = EINVAL;
+        return -1;
+    }
+    *offset = fpos;
+    return 0;
+}
+
+static off_t ring_size(void *handle){
+    return aesd_circular_buffer_calculate_size(&ring.buffer);
+}
+
+static ssize_t ring_read(void *handle, char *buf, size_t len, uint64_t offset){
+    size_t entry_offset;
+    struct aesd_buffer_entry *entry;
+
+    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&ring.buffer, offset, &entry_offset);
+    if(entry == NULL){
+        return 0;
+    }
+    if(len > entry->size - entry_offset){
+        len = entry->size - entry_offset;
+    }
+    memcpy(buf, entry->buffptr + entry_offset, len);
+    return len;
+}
+
+static int ring_send(void *handle, int client_fd, uint64_t offset){
+    struct iovec iov[RING_IOV_BATCH];
+    size_t nr_iov, bytes;
+
+    // Point one iovec at each entry from the one holding offset up to the newest, a batch at a time
+    while( (nr_iov = aesd_circular_buffer_fill_iovec(&ring.buffer, offset, SIZE_MAX, iov, RING_IOV_BATCH, &bytes)) > 0 ){
+        if(aesd_storage_writev_all(client_fd, iov, nr_iov) == -1){
+            return -1;
+        }
+        offset += bytes;
+    }
+    return 0;
+}
+
+const struct aesd_storage_ops aesd_storage_ring_ops = {
+    .name =     "ring",
+    .init =     ring_init,
+    .cleanup =  ring_cleanup,
+    .append =   ring_append,
+    .seekto =   ring_seekto,
+    .size =     ring_size,
+    .read =     ring_read,
+    .send =     ring_send,
+};
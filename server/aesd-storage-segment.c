@@ -0,0 +1,213 @@
+/**
+ * @file aesd-storage-segment.c
+ * @brief aesdsocket storage backend keeping the log as a queue of size-capped segment files
+ *
+ * Packets are appended to the newest segment until it would grow past the
+ * configured segment size, then a new segment file is started.  A packet is
+ * never split across segments, so retention drops whole packets, like the
+ * aesdchar circular buffer evicting its oldest entry.  Retention by total
+ * bytes, segment count or age removes the oldest segment with one close and
+ * one unlink, independent of how much data the log holds.  Offsets start at
+ * the oldest live segment and shift down when it is dropped.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include "queue.h"
+#include "aesd-storage.h"
+
+#define AESD_SEGMENT_PREFIX "/var/tmp/aesdsocketdata.seg."
+#define SEGMENT_PATH_MAX 64
+
+struct segment{
+    uint64_t id;
+    int fd;
+    /* Absolute stream offset of the first byte and bytes held */
+    uint64_t start;
+    size_t size;
+    time_t created;
+    STAILQ_ENTRY(segment) link;
+};
+
+/* Segment list and retention settings, one for all clients */
+static struct{
+    struct aesd_storage_config config;
+    STAILQ_HEAD(segment_head, segment) head;
+    struct segment *newest;
+    unsigned int nr_segments;
+    uint64_t next_id;
+    /* Absolute offset of the oldest live byte and end of stream */
+    uint64_t base;
+    uint64_t end;
+} seg;
+
+static void segment_path(uint64_t id, char *path){
+    snprintf(path, SEGMENT_PATH_MAX, AESD_SEGMENT_PREFIX "%llu", (unsigned long long)id);
+}
+
+// Function to close and remove the oldest segment, O(1) regardless of its size
+static void segment_drop_oldest(void){
+    struct segment *s = STAILQ_FIRST(&seg.head);
+    char path[SEGMENT_PATH_MAX];
+    int err;
+
+    STAILQ_REMOVE_HEAD(&seg.head, link);
+    if(s == seg.newest){
+        seg.newest = NULL;
+    }
+    seg.nr_segments--;
+    seg.base = s->start + s->size;
+
+    close(s->fd);
+    segment_path(s->id, path);
+    if(unlink(path) == -1){
+        err = errno;
+        syslog(LOG_ERR, "Failed to delete log segment %s: %s\n", path, strerror(err));
+    }
+    free(s);
+}
+
+// Function to apply retention limits, the newest segment is always kept
+static void segment_expire(void){
+    time_t now = time(NULL);
+
+    while(seg.nr_segments > 1){
+        struct segment *oldest = STAILQ_FIRST(&seg.head);
+
+        if( (seg.config.max_segments && (seg.nr_segments > seg.config.max_segments)) ||
+                (seg.config.max_bytes && ((seg.end - seg.base) > seg.config.max_bytes)) ||
+                (seg.config.max_age && ((now - oldest->created) > seg.config.max_age)) ){
+            segment_drop_oldest();
+            continue;
+        }
+        break;
+    }
+}
+
+// Function to start a new empty segment at the end of the stream
+static int segment_roll(void){
+    struct segment *s = malloc(sizeof(struct segment));
+    char path[SEGMENT_PATH_MAX];
+
+    if(s == NULL){
+        errno = ENOMEM;
+        return -1;
+    }
+
+    s->id = seg.next_id;
+    segment_path(s->id, path);
+    if( (s->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644)) == -1 ){
+        int err = errno;
+        free(s);
+        errno = err;
+        return -1;
+    }
+
+    seg.next_id++;
+    s->start = seg.end;
+    s->size = 0;
+    s->created = time(NULL);
+    STAILQ_INSERT_TAIL(&seg.head, s, link);
+    seg.newest = s;
+    seg.nr_segments++;
+    return 0;
+}
+
+static void segment_cleanup(void){
+    while(!STAILQ_EMPTY(&seg.head)){
+        segment_drop_oldest();
+    }
+    seg.base = seg.end = 0;
+}
+
+static int segment_init(const struct aesd_storage_config *config){
+    seg.config = *config;
+    if(seg.config.segment_size == 0){
+        seg.config.segment_size = AESD_STORAGE_SEGMENT_SIZE;
+    }
+    STAILQ_INIT(&seg.head);
+    seg.newest = NULL;
+    seg.nr_segments = 0;
+    seg.next_id = 0;
+    seg.base = seg.end = 0;
+    return segment_roll();
+}
+
+static int segment_append(void *handle, const char *buf, size_t len){
+    size_t written = 0;
+
+    // Keep packets whole: start a new segment unless this one is empty or the packet fits
+    if( (seg.newest == NULL) ||
+            ((seg.newest->size > 0) && (seg.newest->size + len > seg.config.segment_size)) ){
+        if(segment_roll() == -1){
+            return -1;
+        }
+    }
+
+    while(written < len){
+        ssize_t result = write(seg.newest->fd, buf + written, len - written);
+        if(result == -1){
+            // Drop the partly written packet, later appends and reads rely on size matching the file
+            int err = errno;
+            if(ftruncate(seg.newest->fd, seg.newest->size) == -1){
+                syslog(LOG_ERR, "Failed to truncate segment %llu: %s\n",
+                        (unsigned long long)seg.newest->id, strerror(errno));
+            }
+            errno = err;
+            return -1;
+        }
+        written += result;
+    }
+    seg.newest->size += len;
+    seg.end += len;
+
+    segment_expire();
+    return 0;
+}
+
+static int segment_seekto(void *handle, const struct aesd_seekto *seekto, uint64_t *offset){
+    // Commands are only tracked by the aesdchar driver
+    errno = ENOTTY;
+    return -1;
+}
+
+static off_t segment_size(void *handle){
+    segment_expire();
+    return seg.end - seg.base;
+}
+
+static ssize_t segment_read(void *handle, char *buf, size_t len, uint64_t offset){
+    uint64_t pos = seg.base + offset;
+    struct segment *s;
+
+    // Replies start at offset 0, drop aged segments before they go out
+    if(offset == 0){
+        segment_expire();
+        pos = seg.base;
+    }
+
+    STAILQ_FOREACH(s, &seg.head, link){
+        if(pos < s->start + s->size){
+            size_t avail = s->start + s->size - pos;
+            return pread(s->fd, buf, (len < avail) ? len : avail, pos - s->start);
+        }
+    }
+    return 0;
+}
+
+const struct aesd_storage_ops aesd_storage_segment_ops = {
+    .name =     "segment",
+    .init =     segment_init,
+    .cleanup =  segment_cleanup,
+    .append =   segment_append,
+    .seekto =   segment_seekto,
+    .size =     segment_size,
+    .read =     segment_read,
+};
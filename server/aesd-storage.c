@@ -0,0 +1,33 @@
+/**
+ * @file aesd-storage.c
+ * @brief Helpers shared by the aesdsocket storage backends, see aesd-storage.h
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <sys/uio.h>
+#include "aesd-storage.h"
+
+int aesd_storage_writev_all(int client_fd, struct iovec *pending, int count){
+    while(count > 0){
+        ssize_t sent = writev(client_fd, pending, count);
+        if(sent == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+
+        // Skip fully sent iovecs and trim a partially sent one
+        while( (count > 0) && ((size_t)sent >= pending->iov_len) ){
+            sent -= pending->iov_len;
+            pending++;
+            count--;
+        }
+        if(count > 0){
+            pending->iov_base = (char *)pending->iov_base + sent;
+            pending->iov_len -= sent;
+        }
+    }
+    return 0;
+}
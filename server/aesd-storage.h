@@ -0,0 +1,135 @@
+/*
+ * aesd-storage.h
+ *
+ *  @brief Storage backends used by aesdsocket to hold received packets
+ *
+ *  A backend is described by a table of operations, like file_operations in
+ *  the char driver.  Every client thread opens its own handle so backends can
+ *  keep per-client state (file position, decompression cache).  All calls
+ *  except init/cleanup/open/close are made with aesdsocket's file_mutex held,
+ *  backends don't need locking of their own.
+ */
+
+#ifndef AESD_STORAGE_H
+#define AESD_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include "../aesd-char-driver/aesd_ioctl.h"
+
+/**
+ * Default segment size of the segment backend
+ */
+#define AESD_STORAGE_SEGMENT_SIZE (64 * 1024)
+/**
+ * Default byte arena size and entry slots of the arena backend
+ */
+#define AESD_STORAGE_ARENA_SIZE (1024 * 1024)
+#define AESD_STORAGE_ARENA_ENTRIES 1024
+
+/**
+ * Settings given on the aesdsocket command line, backends ignore what they don't use.
+ * Zero leaves a limit disabled.
+ */
+struct aesd_storage_config {
+    /**
+     * Segment backend: start a new segment once a packet would grow the current one past this size
+     */
+    size_t segment_size;
+    /**
+     * Segment backend retention: total bytes, number of segments and age in seconds of the oldest segment.
+     * The ring backend evicts its oldest entries to stay within max_bytes, the arena backend
+     * uses it as arena size.
+     */
+    uint64_t max_bytes;
+    unsigned int max_segments;
+    time_t max_age;
+    /**
+     * Ring and arena backends: write commands kept, a power of two (0 keeps the backend default)
+     */
+    uint32_t ring_entries;
+    /**
+     * Ring backend: snapshot file restored at startup and rewritten at shutdown, NULL for none
+     */
+    const char *snapshot_path;
+};
+
+struct aesd_storage_ops {
+    /**
+     * Name used to select the backend with aesdsocket -s
+     */
+    const char *name;
+    /**
+     * Prepare backend storage, returns 0 or -1 with errno set
+     */
+    int (*init)(const struct aesd_storage_config *config);
+    /**
+     * Release backend storage at server shutdown
+     */
+    void (*cleanup)(void);
+    /**
+     * Optional: open a per-client handle, returns NULL with errno set on failure.
+     * Backends keeping no per-client state leave open and close unset and get
+     * a dummy non-NULL handle.
+     */
+    void *(*open)(void);
+    void (*close)(void *handle);
+    /**
+     * Append len bytes, returns 0 or -1 with errno set
+     */
+    int (*append)(void *handle, const char *buf, size_t len);
+    /**
+     * Resolve write command and offset into an absolute byte offset,
+     * returns 0 or -1 with errno set (ENOTTY when unsupported)
+     */
+    int (*seekto)(void *handle, const struct aesd_seekto *seekto, uint64_t *offset);
+    /**
+     * Total bytes currently stored, or -1 with errno set
+     */
+    off_t (*size)(void *handle);
+    /**
+     * Copy up to len bytes starting at offset, returns bytes copied,
+     * 0 at end of storage or -1 with errno set
+     */
+    ssize_t (*read)(void *handle, char *buf, size_t len, uint64_t offset);
+    /**
+     * Optional: send everything from offset to the end straight to client_fd,
+     * for backends that can do better than read() into a bounce buffer.
+     * Returns 0 or -1 with errno set, EOPNOTSUPP when nothing was sent and
+     * the caller should fall back to read().
+     */
+    int (*send)(void *handle, int client_fd, uint64_t offset);
+};
+
+/**
+ * Plain file descriptor backends: the aesdchar device and the append-only log file
+ */
+extern const struct aesd_storage_ops aesd_storage_device_ops;
+extern const struct aesd_storage_ops aesd_storage_file_ops;
+/**
+ * Log file stored as independently compressed fixed-size blocks
+ */
+extern const struct aesd_storage_ops aesd_storage_lz_ops;
+/**
+ * Log file split into size-capped segments with retention limits
+ */
+extern const struct aesd_storage_ops aesd_storage_segment_ops;
+/**
+ * In-process aesd_circular_buffer with aesdchar driver semantics, for hosts without the module
+ */
+extern const struct aesd_storage_ops aesd_storage_ring_ops;
+/**
+ * In-process aesd_circular_arena, driver semantics with payloads in one byte arena
+ */
+extern const struct aesd_storage_ops aesd_storage_arena_ops;
+
+/**
+ * Write every byte described by count iovecs to client_fd, retrying partial writes.
+ * Updates the iovecs.  Returns 0 or -1 with errno set.
+ */
+int aesd_storage_writev_all(int client_fd, struct iovec *pending, int count);
+
+#endif /* AESD_STORAGE_H */
@@ -0,0 +1,102 @@
+/*
+ * aesd_protocol.h
+ *
+ *  @brief Wire format of the aesdsocket length-prefixed binary protocol
+ *
+ *  A connection switches to binary mode when its first bytes are
+ *  AESD_PROTO_MAGIC.  The server answers with the same preamble and from then
+ *  on both sides exchange frames: a struct aesd_frame_header followed by
+ *  length bytes of payload.  Every request gets exactly one reply, in request
+ *  order, carrying the same request_id and opcode so pipelined clients can
+ *  match them up.  Connections not starting with the preamble keep the
+ *  newline framed text protocol.
+ *
+ *  All multi-byte fields are in network byte order.
+ */
+
+#ifndef AESD_PROTOCOL_H
+#define AESD_PROTOCOL_H
+
+#include <stdint.h>
+
+/**
+ * Preamble selecting binary mode; the leading 0xae byte never starts a text packet.
+ * The last byte is the protocol version.
+ */
+#define AESD_PROTO_MAGIC        "\xae\x5d" "B\x01"
+#define AESD_PROTO_MAGIC_LEN    4
+
+/**
+ * Largest payload accepted or returned in a single frame
+ */
+#define AESD_PROTO_MAX_PAYLOAD  (16 * 1024 * 1024)
+
+/**
+ * Frame header sent before each request and reply payload
+ */
+struct aesd_frame_header {
+    /**
+     * Number of payload bytes following the header
+     */
+    uint32_t length;
+    /**
+     * Client chosen identifier, echoed back in the reply
+     */
+    uint32_t request_id;
+    /**
+     * One of enum aesd_opcode
+     */
+    uint16_t opcode;
+    /**
+     * Zero in requests; zero or a positive errno value in replies
+     */
+    uint16_t status;
+};
+
+enum aesd_opcode {
+    /**
+     * Request: bytes to append to storage, stored verbatim (no newline scan).
+     * Reply: empty.
+     */
+    AESD_OP_APPEND = 1,
+    /**
+     * Request: struct aesd_proto_seekto.
+     * Reply: uint64_t byte offset of the command, usable with AESD_OP_READ.
+     */
+    AESD_OP_SEEKTO = 2,
+    /**
+     * Request: struct aesd_proto_read.
+     * Reply: up to length bytes of storage starting at offset.
+     */
+    AESD_OP_READ = 3,
+    /**
+     * Request: empty.
+     * Reply: struct aesd_proto_stats.
+     */
+    AESD_OP_STATS = 4,
+};
+
+struct aesd_proto_seekto {
+    uint32_t write_cmd;
+    uint32_t write_cmd_offset;
+};
+
+struct aesd_proto_read {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct aesd_proto_stats {
+    /**
+     * Bytes currently held by storage
+     */
+    uint64_t total_bytes;
+    /**
+     * Bytes and requests appended through this server since startup, both protocols
+     */
+    uint64_t appended_bytes;
+    uint64_t appends;
+};
+
+#endif /* AESD_PROTOCOL_H */
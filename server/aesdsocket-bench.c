@@ -0,0 +1,235 @@
+/*
+ * aesdsocket-bench.c
+ *
+ * Latency and throughput comparison of the aesdsocket TCP listener against
+ * the optional local AF_UNIX listener (aesdsocket -u <path>).
+ *
+ * Each iteration opens a connection, sends one newline terminated packet and
+ * reads the reply until the server closes the connection, exactly like the
+ * assignment socket tests.  TCP and local iterations are interleaved so both
+ * see the same reply size as the stored log grows.
+ *
+ * Usage: aesdsocket-bench [-h host] [-p port] [-u socket_path|@abstract_name]
+ *                         [-n iterations] [-s packet_size]
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_HOST "localhost"
+#define DEFAULT_PORT "9000"
+
+struct bench_result{
+    const char *name;
+    double *latency_us;     // Per iteration round trip time
+    size_t samples;
+    size_t bytes;           // Bytes sent and received
+    double total_us;
+};
+
+static double now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+// Function to connect over TCP, returns socket file descriptor or -1
+static int connect_tcp(const char *host, const char *port){
+    int fd = -1;
+    struct addrinfo hints, *res, *rp;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &res) != 0){
+        return -1;
+    }
+
+    for(rp = res; rp != NULL; rp = rp->ai_next){
+        if( (fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol)) == -1 ){
+            continue;
+        }
+        if(connect(fd, rp->ai_addr, rp->ai_addrlen) == 0){
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+    return fd;
+}
+
+// Function to connect to a filesystem or abstract ('@' prefixed) AF_UNIX socket
+static int connect_unix(const char *path){
+    int fd;
+    size_t path_len = strlen(path);
+    socklen_t addr_len;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( (path_len == 0) || (path_len >= sizeof(addr.sun_path)) ){
+        return -1;
+    }
+
+    if(path[0] == '@'){
+        memcpy(addr.sun_path + 1, path + 1, path_len - 1);
+        addr_len = offsetof(struct sockaddr_un, sun_path) + path_len;
+    }else{
+        memcpy(addr.sun_path, path, path_len);
+        addr_len = offsetof(struct sockaddr_un, sun_path) + path_len + 1;
+    }
+
+    if( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ){
+        return -1;
+    }
+    if(connect(fd, (struct sockaddr *)&addr, addr_len) == -1){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to send one packet and drain the reply, returns bytes moved or -1
+static ssize_t round_trip(int fd, const char *packet, size_t packet_len){
+    char buf[4096];
+    size_t sent = 0;
+    ssize_t moved = 0, n;
+
+    while(sent < packet_len){
+        if( (n = send(fd, packet + sent, packet_len - sent, 0)) == -1 ){
+            return -1;
+        }
+        sent += n;
+    }
+    moved = sent;
+
+    while( (n = recv(fd, buf, sizeof(buf), 0)) > 0 ){
+        moved += n;
+    }
+    return (n == -1) ? -1 : moved;
+}
+
+static int compare_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(struct bench_result *r){
+    double sum = 0;
+
+    if(r->samples == 0){
+        printf("%-6s no samples\n", r->name);
+        return;
+    }
+
+    for(size_t i = 0; i < r->samples; i++){
+        sum += r->latency_us[i];
+    }
+    qsort(r->latency_us, r->samples, sizeof(double), compare_double);
+
+    printf("%-6s n=%zu mean=%.1fus p50=%.1fus p99=%.1fus throughput=%.2fMB/s\n",
+            r->name, r->samples, sum / r->samples,
+            r->latency_us[r->samples / 2],
+            r->latency_us[(r->samples * 99) / 100],
+            (r->bytes / (1024.0 * 1024.0)) / (r->total_us / 1e6));
+}
+
+static int run_once(struct bench_result *r, int fd, const char *packet, size_t packet_len){
+    double start;
+    ssize_t moved;
+
+    if(fd == -1){
+        perror("connect");
+        return -1;
+    }
+
+    start = now_us();
+    moved = round_trip(fd, packet, packet_len);
+    r->latency_us[r->samples] = now_us() - start;
+    close(fd);
+
+    if(moved == -1){
+        perror("round trip");
+        return -1;
+    }
+
+    r->total_us += r->latency_us[r->samples];
+    r->bytes += moved;
+    r->samples++;
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    const char *host = DEFAULT_HOST;
+    const char *port = DEFAULT_PORT;
+    const char *unix_path = NULL;
+    size_t iterations = 1000;
+    size_t packet_len = 64;
+    struct bench_result tcp = { .name = "tcp" }, local = { .name = "unix" };
+    char *packet;
+    int opt, rc = 0;
+
+    while( (opt = getopt(argc, argv, "h:p:u:n:s:")) != -1 ){
+        switch(opt){
+            case 'h': host = optarg; break;
+            case 'p': port = optarg; break;
+            case 'u': unix_path = optarg; break;
+            case 'n': iterations = strtoul(optarg, NULL, 0); break;
+            case 's': packet_len = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "Usage: %s [-h host] [-p port] [-u socket_path|@abstract_name] "
+                        "[-n iterations] [-s packet_size]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if( (iterations == 0) || (packet_len == 0) ){
+        fprintf(stderr, "Iterations and packet size must be non-zero\n");
+        return 1;
+    }
+
+    // Printable payload terminated by the newline that completes a packet
+    packet = malloc(packet_len);
+    tcp.latency_us = calloc(iterations, sizeof(double));
+    local.latency_us = calloc(iterations, sizeof(double));
+    if( (packet == NULL) || (tcp.latency_us == NULL) || (local.latency_us == NULL) ){
+        perror("malloc");
+        return 1;
+    }
+    for(size_t i = 0; i < packet_len - 1; i++){
+        packet[i] = 'a' + (i % 26);
+    }
+    packet[packet_len - 1] = '\n';
+
+    for(size_t i = 0; (i < iterations) && (rc == 0); i++){
+        rc = run_once(&tcp, connect_tcp(host, port), packet, packet_len);
+        if( (rc == 0) && (unix_path != NULL) ){
+            rc = run_once(&local, connect_unix(unix_path), packet, packet_len);
+        }
+    }
+
+    report(&tcp);
+    if(unix_path != NULL){
+        report(&local);
+        if( (tcp.samples > 0) && (local.samples > 0) ){
+            printf("unix/tcp mean latency ratio: %.2f\n",
+                    (local.total_us / local.samples) / (tcp.total_us / tcp.samples));
+        }
+    }
+
+    free(packet);
+    free(tcp.latency_us);
+    free(local.latency_us);
+    return (rc == 0) ? 0 : 1;
+}
@@ -2,6 +2,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -15,28 +17,54 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <time.h>
+#include <poll.h>
+#include <stddef.h>
 #include <sys/ioctl.h>
 #include "queue.h"
+#include "aesd_protocol.h"
+#include "aesd-storage.h"
 #include "../aesd-char-driver/aesd_ioctl.h"
 
 #define PORT "9000"
 #define BACKLOG 10
 #define USE_AESD_CHAR_DEVICE 1 // Comment to disable write to driver
+#define PREAMBLE_TIMEOUT 5 // Seconds to wait for the rest of a partial binary preamble
 
-/* Build switch to select write to output file or driver */
+/* Build switch to select the default storage: driver or output file */
 #ifdef USE_AESD_CHAR_DEVICE
-    #define OUTPUT_FILE "/dev/aesdchar"
+    #define DEFAULT_STORAGE (&aesd_storage_device_ops)
 #else
-    #define OUTPUT_FILE "/var/tmp/aesdsocketdata"
+    #define DEFAULT_STORAGE (&aesd_storage_file_ops)
 #endif
 
 // Global variables
 static volatile sig_atomic_t active = 1;
 
+// Storage backends selectable with '-s', the default is picked by the build switch above
+static const struct aesd_storage_ops *const storage_backends[] = {
+    &aesd_storage_device_ops,
+    &aesd_storage_file_ops,
+    &aesd_storage_lz_ops,
+    &aesd_storage_segment_ops,
+    &aesd_storage_ring_ops,
+    &aesd_storage_arena_ops,
+};
+static const struct aesd_storage_ops *storage = DEFAULT_STORAGE;
+static struct aesd_storage_config storage_config = {
+    .segment_size = AESD_STORAGE_SEGMENT_SIZE,
+};
+
+// Optional AF_UNIX listener path given with '-u', a leading '@' selects the abstract namespace
+static const char *unix_path = NULL;
+
 // Mutexes for file and list operations
 static pthread_mutex_t file_mutex;
 static pthread_mutex_t list_mutex;
 
+// Append counters reported by AESD_OP_STATS, protected by file_mutex
+static uint64_t appended_bytes;
+static uint64_t appends;
+
 // Client data structure for thread pool
 struct thread_data{
     pthread_t thread_id;
@@ -104,6 +132,81 @@ int setup_server(void){
     return server_fd;
 }
 
+// Function to build the AF_UNIX address for path, returns address length or -1 if path does not fit
+static int unix_address(const char *path, struct sockaddr_un *addr){
+    size_t path_len = strlen(path);
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    // Keep room for the terminating null character (filesystem) or leading null byte (abstract)
+    if( (path_len == 0) || (path_len >= sizeof(addr->sun_path)) ){
+        return -1;
+    }
+
+    if(path[0] == '@'){
+        // Abstract namespace: name starts with a null byte and is not null terminated
+        memcpy(addr->sun_path + 1, path + 1, path_len - 1);
+        return offsetof(struct sockaddr_un, sun_path) + path_len;
+    }
+
+    memcpy(addr->sun_path, path, path_len);
+    return offsetof(struct sockaddr_un, sun_path) + path_len + 1;
+}
+
+// Function to setup local AF_UNIX stream socket, served by the same accept and handler pipeline as TCP
+int setup_unix_server(const char *path){
+    int server_fd, err;
+    int addr_len;
+    struct sockaddr_un server_addr;
+
+    if( (addr_len = unix_address(path, &server_addr)) == -1 ){
+        syslog(LOG_ERR, "Invalid local socket path: %s\n", path);
+        return -1;
+    }
+
+    if( (server_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ){
+        err = errno;
+        syslog(LOG_ERR, "Local socket creation failed: %s\n", strerror(err));
+        return -1;
+    }
+
+    // Remove stale socket file left behind by a previous run, abstract names vanish with their socket
+    if( (path[0] != '@') && (unlink(path) == -1) && (errno != ENOENT) ){
+        err = errno;
+        syslog(LOG_ERR, "Removing stale local socket failed: %s\n", strerror(err));
+        close(server_fd);
+        return -1;
+    }
+
+    if( (bind(server_fd, (struct sockaddr *)&server_addr, addr_len)) == -1 ){
+        err = errno;
+        syslog(LOG_ERR, "Local socket binding failed: %s\n", strerror(err));
+        close(server_fd);
+        return -1;
+    }
+    syslog(LOG_DEBUG, "Local socket file descriptor: %d", server_fd);
+
+    return server_fd;
+}
+
+// Function to close local socket and remove its filesystem entry
+void close_unix_server(int server_fd, const char *path){
+    int err;
+
+    if(server_fd == -1){
+        return;
+    }
+
+    close(server_fd);
+    if( (path[0] != '@') && (unlink(path) == -1) ){
+        err = errno;
+        if(err != ENOENT){
+            syslog(LOG_ERR, "Failed to delete local socket: %s\n", strerror(err));
+        }
+    }
+}
+
 // Function to handle client connection and return client file descriptor
 int client_setup(int server_fd){
     int client_fd, err;
@@ -121,6 +224,13 @@ int client_setup(int server_fd){
         return -1;
     }
 
+    // Local clients have no IP address to report
+    if(client_addr.ss_family == AF_UNIX){
+        syslog(LOG_DEBUG, "Accepted local connection");
+        syslog(LOG_DEBUG, "Client file descriptor: %d", client_fd);
+        return client_fd;
+    }
+
     // Get client information and print client IP once connection is stablished
     if(client_addr.ss_family == AF_INET){
         struct sockaddr_in *s = (struct sockaddr_in *)&client_addr;
@@ -135,15 +245,45 @@ int client_setup(int server_fd){
     return client_fd;
 }
 
-// Function to receive data from client and write to file/device
-int receive_data(int client_fd, int file_fd){
+// Function to wait on TCP and optional local listener, returns accepted client file descriptor
+int accept_next(int server_fd, int unix_fd){
+    int err;
+    struct pollfd fds[2];
+
+    // Without a local listener keep the plain blocking accept
+    if(unix_fd == -1){
+        return client_setup(server_fd);
+    }
+
+    fds[0].fd = server_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = unix_fd;
+    fds[1].events = POLLIN;
+
+    if( poll(fds, 2, -1) == -1 ){
+        err = errno;
+        // Don't log error if interrupted by signal
+        if(err != EINTR){
+            syslog(LOG_ERR, "Waiting for incoming connections failed: %s\n", strerror(err));
+        }
+        return -1;
+    }
+
+    // Serve local clients first, they are the latency sensitive producers
+    if(fds[1].revents & POLLIN){
+        return client_setup(unix_fd);
+    }
+    return client_setup(server_fd);
+}
+
+// Function to receive data from client and write to storage, sets reply_offset where the reply should start
+int receive_data(int client_fd, void *store, uint64_t *reply_offset){
     // Define variables for data packet buffer
     int err;
     int buf_size = 1024; //Start with 1kb for buffer size
     int packet_size = 0;
     int bytes_received;
     char *newline_pos = NULL;
-    int ioctl_seekto_received = 0;
     
     /* Allocation memory for buffer */
     char *buf = malloc(buf_size);
@@ -164,7 +304,6 @@ int receive_data(int client_fd, int file_fd){
         // Found new line character which indicates a single packet has been completely recieved
         if(newline_pos != NULL){
             int packet_length = (newline_pos - buf) + 1; // Calculate length of complete packet (buffer size - position of newline + 1 to include newline)
-            int bytes_written = 0; // Track number of bytes written to file
             
             /* Define variables in case ioctl function is called */
             char command[22];  // Buffer for command string (21 chars + null terminator)
@@ -180,8 +319,8 @@ int receive_data(int client_fd, int file_fd){
                     /* Lock file/device for seek operation in circular buffer */
                     pthread_mutex_lock(&file_mutex);
 
-                    /* Review if ioctl found any error */
-                    if ( ioctl(file_fd, AESDCHAR_IOCSEEKTO, &seekto) < 0 ){
+                    /* Review if ioctl found any error, reply starts at the command offset */
+                    if ( storage->seekto(store, &seekto, reply_offset) == -1 ){
                         err = errno;
                         syslog(LOG_ERR, "ioctl function could not be performed: %s\n", strerror(err));
                         pthread_mutex_unlock(&file_mutex);
@@ -191,7 +330,6 @@ int receive_data(int client_fd, int file_fd){
 
                     /* Once done, release locks and reset buffers and packet_size */
                     pthread_mutex_unlock(&file_mutex);
-                    ioctl_seekto_received = 1;
                     packet_size = 0;
                     memset(buf, 0, buf_size);
 
@@ -203,22 +341,16 @@ int receive_data(int client_fd, int file_fd){
             /* Lock file/device for writing */ 
             pthread_mutex_lock(&file_mutex); 
 
-            /* Write to output file if there's no ioctl function send */
-            while(bytes_written < packet_length){
-                int result = write(file_fd, (buf + bytes_written), (packet_length - bytes_written));
-                
-                /* In case file write fails */
-                if(result == -1){
-                    err = errno;
-                    syslog(LOG_ERR, "Writing to file failed: %s\n", strerror(err));
-                    pthread_mutex_unlock(&file_mutex);
-                    free(buf);
-                    return -1; // Exit with error
-                }
-
-                /* Add result to bytes written to review if buffer was fully written to file */
-                bytes_written += result;
+            /* Write to storage if there's no ioctl function send */
+            if(storage->append(store, buf, packet_length) == -1){
+                err = errno;
+                syslog(LOG_ERR, "Writing to file failed: %s\n", strerror(err));
+                pthread_mutex_unlock(&file_mutex);
+                free(buf);
+                return -1; // Exit with error
             }
+            appended_bytes += packet_length;
+            appends++;
             
             /* Once done, release locks and reset buffers and packet_size */
             pthread_mutex_unlock(&file_mutex); 
@@ -256,29 +388,34 @@ int receive_data(int client_fd, int file_fd){
     // Client closed connection, finalize data reception
     syslog(LOG_DEBUG, "Data reception from client finalized");
 
-    /*
-     * For normal writes, response should begin at start of device/file.
-     * For AESDCHAR_IOCSEEKTO, preserve ioctl-adjusted position.
-     */
-    if(!ioctl_seekto_received){
-        if(lseek(file_fd, 0, SEEK_SET) == -1){
-            err = errno;
-            syslog(LOG_ERR, "File seek failed: %s\n", strerror(err));
-            free(buf);
-            return -1;
-        }
-    }
-
     free(buf); // Free buffer memory of unwritten data of last packet
     
     return 0;
 }
 
-// Function to send data from file/device back to client
-int send_data(int client_fd, int file_fd){
+// Function to send data from storage back to client, starting at offset
+int send_data(int client_fd, void *store, uint64_t offset){
     int err, bytes_read;
     int buf_size = 1024;
-    char *buf = malloc(buf_size);
+    char *buf;
+
+    // Let backends that hold data in memory or support sendfile send it without a bounce buffer
+    if(storage->send != NULL){
+        pthread_mutex_lock(&file_mutex);
+        if(storage->send(store, client_fd, offset) == -1){
+            err = errno;
+            pthread_mutex_unlock(&file_mutex);
+            if(err != EOPNOTSUPP){
+                syslog(LOG_ERR, "Sending data to client failed: %s\n", strerror(err));
+                return -1;
+            }
+        }else{
+            pthread_mutex_unlock(&file_mutex);
+            return 0;
+        }
+    }
+
+    buf = malloc(buf_size);
 
     // Error handling for memory allocation
     if(buf == NULL){
@@ -290,8 +427,9 @@ int send_data(int client_fd, int file_fd){
     pthread_mutex_lock(&file_mutex); // Lock file/device for seek+read
 
     // Read and send data from file in chunks
-    while( (bytes_read = read(file_fd, buf, buf_size)) > 0 ){
+    while( (bytes_read = storage->read(store, buf, buf_size, offset)) > 0 ){
         int total_sent = 0;
+        offset += bytes_read;
         // Send all bytes read from file
         while(total_sent < bytes_read){
             int sent = send(client_fd, buf + total_sent, bytes_read - total_sent, 0);
@@ -318,20 +456,323 @@ int send_data(int client_fd, int file_fd){
     return 0;
 }
 
+// Function to convert 64 bit values to and from network byte order
+static uint64_t hton64(uint64_t value){
+    if(htonl(1) == 1){
+        return value;
+    }
+    return ((uint64_t)htonl(value & 0xffffffff) << 32) | htonl(value >> 32);
+}
+#define ntoh64 hton64
+
+// Function to receive exactly len bytes, returns 0 on success, 1 if peer closed before any byte, -1 on error
+static int recv_all(int client_fd, void *buf, size_t len){
+    size_t received = 0;
+
+    while(received < len){
+        ssize_t n = recv(client_fd, (char *)buf + received, len - received, 0);
+        if(n == 0){
+            return (received == 0) ? 1 : -1;
+        }
+        if(n == -1){
+            if(errno == EINTR && active){
+                continue;
+            }
+            return -1;
+        }
+        received += n;
+    }
+    return 0;
+}
+
+// Function to send exactly len bytes, returns 0 on success or -1 on error
+static int send_all(int client_fd, const void *buf, size_t len){
+    size_t sent = 0;
+
+    while(sent < len){
+        ssize_t n = send(client_fd, (const char *)buf + sent, len - sent, 0);
+        if(n == -1){
+            if(errno == EINTR && active){
+                continue;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+/*
+ * Function to detect binary protocol preamble without consuming text data.
+ * Returns 1 for binary mode, 0 for text mode and -1 if connection failed.
+ */
+static int detect_binary_protocol(int client_fd){
+    char peek[AESD_PROTO_MAGIC_LEN];
+    struct timeval timeout = { .tv_sec = PREAMBLE_TIMEOUT, .tv_usec = 0 };
+    int flags = MSG_PEEK;
+    ssize_t n, seen = 0;
+    int result = -1;
+
+    while(active){
+        n = recv(client_fd, peek, sizeof(peek), flags);
+        if(n == -1 && errno == EINTR){
+            continue;
+        }
+        // Closed connections and errors are reported by text mode as before, so are stalled preambles
+        if( (n <= seen) || (memcmp(peek, AESD_PROTO_MAGIC, n) != 0) ){
+            result = 0;
+            break;
+        }
+        if(n == AESD_PROTO_MAGIC_LEN){
+            // Consume preamble and acknowledge binary mode
+            if( (recv_all(client_fd, peek, sizeof(peek)) != 0) ||
+                    (send_all(client_fd, AESD_PROTO_MAGIC, AESD_PROTO_MAGIC_LEN) == -1) ){
+                break;
+            }
+            result = 1;
+            break;
+        }
+        // Partial preamble, block until the rest arrives or PREAMBLE_TIMEOUT passes without progress
+        seen = n;
+        if( !(flags & MSG_WAITALL) ){
+            if(setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1){
+                result = 0;
+                break;
+            }
+            flags |= MSG_WAITALL;
+        }
+    }
+    if(flags & MSG_WAITALL){
+        timeout.tv_sec = 0;
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    return result;
+}
+
+// Function to send reply header followed by payload
+static int send_reply(int client_fd, const struct aesd_frame_header *request, int status,
+                      const void *payload, uint32_t length){
+    struct aesd_frame_header reply;
+
+    reply.length = htonl(length);
+    reply.request_id = htonl(request->request_id);
+    reply.opcode = htons(request->opcode);
+    reply.status = htons(status);
+
+    if(send_all(client_fd, &reply, sizeof(reply)) == -1){
+        return -1;
+    }
+    return (length > 0) ? send_all(client_fd, payload, length) : 0;
+}
+
+// Function to write payload to storage in one locked pass, returns 0 or errno
+static int binary_append(void *store, const char *payload, uint32_t length){
+    int err = 0;
+
+    pthread_mutex_lock(&file_mutex);
+    if(storage->append(store, payload, length) == -1){
+        err = errno;
+        syslog(LOG_ERR, "Writing to file failed: %s\n", strerror(err));
+    }else{
+        appended_bytes += length;
+        appends++;
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return err;
+}
+
+// Function to resolve a command index into a byte offset, returns 0 or errno
+static int binary_seekto(void *store, const struct aesd_proto_seekto *request, uint64_t *offset){
+    struct aesd_seekto seekto;
+    int err = 0;
+
+    seekto.write_cmd = ntohl(request->write_cmd);
+    seekto.write_cmd_offset = ntohl(request->write_cmd_offset);
+
+    pthread_mutex_lock(&file_mutex);
+    if(storage->seekto(store, &seekto, offset) == -1){
+        err = errno;
+    }
+    pthread_mutex_unlock(&file_mutex);
+    return err;
+}
+
+// Function to read a byte range into a newly allocated buffer, returns 0 or errno
+static int binary_read(void *store, const struct aesd_proto_read *request, char **data, uint32_t *length){
+    uint64_t offset = ntoh64(request->offset);
+    uint32_t wanted = ntohl(request->length);
+    uint32_t got = 0;
+    off_t size;
+    int err = 0;
+
+    if(wanted > AESD_PROTO_MAX_PAYLOAD){
+        wanted = AESD_PROTO_MAX_PAYLOAD;
+    }
+
+    pthread_mutex_lock(&file_mutex);
+    if( (size = storage->size(store)) == -1 ){
+        err = errno;
+        goto out;
+    }
+    if(offset >= (uint64_t)size){
+        wanted = 0;
+    }else if(wanted > (uint64_t)size - offset){
+        wanted = size - offset;
+    }
+
+    if( (*data = malloc(wanted ? wanted : 1)) == NULL ){
+        err = ENOMEM;
+        goto out;
+    }
+
+    // Device reads stop at entry boundaries, keep reading until range is filled
+    while(got < wanted){
+        ssize_t result = storage->read(store, *data + got, wanted - got, offset + got);
+        if(result <= 0){
+            if(result == -1){
+                err = errno;
+                free(*data);
+                *data = NULL;
+                goto out;
+            }
+            break;
+        }
+        got += result;
+    }
+    *length = got;
+
+    out:
+    pthread_mutex_unlock(&file_mutex);
+    return err;
+}
+
+// Function to serve pipelined binary frames until the client closes the connection
+int binary_session(int client_fd, void *store){
+    struct aesd_frame_header request;
+    char *payload = NULL;
+    int rc = 0;
+
+    while(active){
+        char *reply = NULL;
+        uint32_t reply_len = 0;
+        uint64_t reply_u64[3];
+        int status = 0;
+
+        if( (rc = recv_all(client_fd, &request, sizeof(request))) != 0 ){
+            // Closing between frames ends the session normally
+            rc = (rc == 1) ? 0 : -1;
+            break;
+        }
+        request.length = ntohl(request.length);
+        request.request_id = ntohl(request.request_id);
+        request.opcode = ntohs(request.opcode);
+
+        if(request.length > AESD_PROTO_MAX_PAYLOAD){
+            // Can't resynchronize with the stream, reject and drop connection
+            send_reply(client_fd, &request, EMSGSIZE, NULL, 0);
+            rc = -1;
+            break;
+        }
+
+        // Read exactly the announced payload, no scanning for delimiters
+        free(payload);
+        if( (payload = malloc(request.length ? request.length : 1)) == NULL ){
+            syslog(LOG_ERR, "Memory allocation failed: %s\n", strerror(ENOMEM));
+            rc = -1;
+            break;
+        }
+        if( (request.length > 0) && (recv_all(client_fd, payload, request.length) != 0) ){
+            syslog(LOG_ERR, "Frame reception from client failed\n");
+            rc = -1;
+            break;
+        }
+
+        switch(request.opcode){
+            case AESD_OP_APPEND:
+                status = binary_append(store, payload, request.length);
+                break;
+
+            case AESD_OP_SEEKTO:
+                if(request.length != sizeof(struct aesd_proto_seekto)){
+                    status = EINVAL;
+                    break;
+                }
+                if( (status = binary_seekto(store, (struct aesd_proto_seekto *)payload, &reply_u64[0])) == 0 ){
+                    reply_u64[0] = hton64(reply_u64[0]);
+                    reply = (char *)reply_u64;
+                    reply_len = sizeof(uint64_t);
+                }
+                break;
+
+            case AESD_OP_READ:
+                if(request.length != sizeof(struct aesd_proto_read)){
+                    status = EINVAL;
+                    break;
+                }
+                status = binary_read(store, (struct aesd_proto_read *)payload, &reply, &reply_len);
+                break;
+
+            case AESD_OP_STATS: {
+                off_t size;
+
+                pthread_mutex_lock(&file_mutex);
+                size = storage->size(store);
+                reply_u64[1] = hton64(appended_bytes);
+                reply_u64[2] = hton64(appends);
+                pthread_mutex_unlock(&file_mutex);
+
+                if(size == -1){
+                    status = errno;
+                    break;
+                }
+                reply_u64[0] = hton64(size);
+                reply = (char *)reply_u64;
+                reply_len = sizeof(struct aesd_proto_stats);
+                break;
+            }
+
+            default:
+                status = EOPNOTSUPP;
+                break;
+        }
+
+        rc = send_reply(client_fd, &request, status, reply, status ? 0 : reply_len);
+        if(request.opcode == AESD_OP_READ){
+            free(reply);
+        }
+        if(rc == -1){
+            syslog(LOG_ERR, "Sending frame to client failed: %s\n", strerror(errno));
+            break;
+        }
+    }
+
+    free(payload);
+    return rc;
+}
+
+/* Open a storage handle for one client, backends without per-client state leave open unset */
+static void *storage_open(void){
+    static char shared_handle;
+
+    return (storage->open != NULL) ? storage->open() : &shared_handle;
+}
+
+static void storage_close(void *store){
+    if(storage->close != NULL){
+        storage->close(store);
+    }
+}
+
 // Define thread handler function
 void *client_handler(void *args){
     struct thread_data *data = (struct thread_data *)args;
     int client_fd = data->client_fd;
-    int file_fd, err;
-
-    // Open file/device for this client
-    #ifdef USE_AESD_CHAR_DEVICE
-    file_fd = open(OUTPUT_FILE, O_RDWR);
-    #else
-    file_fd = open(OUTPUT_FILE, O_RDWR | O_CREAT | O_APPEND, 0644);
-    #endif
+    int err;
+    void *store;
+    uint64_t reply_offset = 0;
 
-    if(file_fd == -1){
+    // Open storage for this client
+    if( (store = storage_open()) == NULL ){
         err = errno;
         syslog(LOG_ERR, "Opening output file failed: %s\n", strerror(err));
         close(client_fd);
@@ -341,9 +782,25 @@ void *client_handler(void *args){
         pthread_exit(NULL);
     }
 
+    // Connections opening with the binary preamble are served frame by frame until closed
+    switch(detect_binary_protocol(client_fd)){
+        case 1:
+            binary_session(client_fd, store);
+            /* fall through */
+        case -1:
+            storage_close(store);
+            close(client_fd);
+            pthread_mutex_lock(&list_mutex);
+            data->thread_complete = 1;
+            pthread_mutex_unlock(&list_mutex);
+            return NULL;
+        default:
+            break;
+    }
+
     // Receive data packets from client and write to file immediately
-    if( (receive_data(client_fd, file_fd)) == -1 ){
-        close(file_fd);
+    if( (receive_data(client_fd, store, &reply_offset)) == -1 ){
+        storage_close(store);
         close(client_fd);
         pthread_mutex_lock(&list_mutex);
         data->thread_complete = 1;
@@ -352,8 +809,8 @@ void *client_handler(void *args){
     }
 
     // Send back data saved in output file to client
-    if( (send_data(client_fd, file_fd)) == -1 ){
-        close(file_fd);
+    if( (send_data(client_fd, store, reply_offset)) == -1 ){
+        storage_close(store);
         close(client_fd);
         pthread_mutex_lock(&list_mutex);
         data->thread_complete = 1;
@@ -361,7 +818,7 @@ void *client_handler(void *args){
         pthread_exit(NULL);
     }
 
-    close(file_fd); // Close file/device
+    storage_close(store); // Close file/device
     close(client_fd); // Close client connection after data transfer is done
 
     pthread_mutex_lock(&list_mutex);
@@ -370,7 +827,6 @@ void *client_handler(void *args){
     return NULL;
 }
 
-#ifndef USE_AESD_CHAR_DEVICE
 void *stamper_handler(void *args){
     int err;
 
@@ -381,23 +837,23 @@ void *stamper_handler(void *args){
 
         strftime(time_buffer, sizeof(time_buffer), "timestamp:%a, %d %b %Y %T %z\n", tm_info); // Format time string
 
-        int file_fd = open(OUTPUT_FILE, O_RDWR | O_CREAT | O_APPEND, 0644);
-        if(file_fd == -1){
+        void *store = storage_open();
+        if(store == NULL){
             err = errno;
             syslog(LOG_ERR, "Opening output file for timestamp failed: %s\n", strerror(err));
             break;
         }
 
         pthread_mutex_lock(&file_mutex);
-        if(write(file_fd, time_buffer, strlen(time_buffer)) == -1){
+        if(storage->append(store, time_buffer, strlen(time_buffer)) == -1){
             err = errno;
             syslog(LOG_ERR, "Writing timestamp to file failed: %s\n", strerror(err));
-            close(file_fd);
+            storage_close(store);
             pthread_mutex_unlock(&file_mutex);
             break;
         }
 
-        close(file_fd);
+        storage_close(store);
         pthread_mutex_unlock(&file_mutex);
 
         // Sleep for 10 seconds, checking active flag each second for improved responsiveness
@@ -411,12 +867,70 @@ void *stamper_handler(void *args){
 
     return NULL;
 }
-#endif
 
 int main(int argc, char* argv[]){
-    int server_fd, err;
+    int server_fd, err, opt;
+    int unix_fd = -1;
+    int daemon_mode = 0;
+    int stamper_started = 0;
+    pthread_t stamper_thread;
     openlog(NULL, 0, LOG_USER);
 
+    /*
+     * Parse options: '-d' runs as daemon, '-u <path>' adds a local AF_UNIX listener, '-s <name>' picks storage.
+     * Segment storage takes '-S <segment bytes>' and retention limits '-b <bytes>', '-n <segments>', '-a <seconds>'.
+     * Ring storage keeps '-e <entries>' write commands, a power of two, within the '-b <bytes>' budget.
+     * Arena storage keeps '-e <entries>' write commands in an arena of '-b <bytes>', both powers of two.
+     * Ring storage saves its entries to '-r <file>' at shutdown and restores them from it at startup,
+     * give an absolute path with '-d' since the daemon changes to '/'.
+     */
+    while( (opt = getopt(argc, argv, "du:s:S:b:n:a:e:r:")) != -1 ){
+        switch(opt){
+            case 'd':
+                daemon_mode = 1;
+                break;
+            case 'u':
+                unix_path = optarg;
+                break;
+            case 'S':
+                storage_config.segment_size = strtoull(optarg, NULL, 0);
+                break;
+            case 'b':
+                storage_config.max_bytes = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                storage_config.max_segments = strtoul(optarg, NULL, 0);
+                break;
+            case 'a':
+                storage_config.max_age = strtol(optarg, NULL, 0);
+                break;
+            case 'e':
+                storage_config.ring_entries = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                storage_config.snapshot_path = optarg;
+                break;
+            case 's':
+                storage = NULL;
+                for(size_t i = 0; i < sizeof(storage_backends) / sizeof(storage_backends[0]); i++){
+                    if(strcmp(optarg, storage_backends[i]->name) == 0){
+                        storage = storage_backends[i];
+                    }
+                }
+                if(storage != NULL){
+                    break;
+                }
+                fprintf(stderr, "Unknown storage '%s'\n", optarg);
+                /* fall through */
+            default:
+                fprintf(stderr, "Usage: %s [-d] [-u socket_path|@abstract_name] [-s device|file|lz|segment|ring|arena]\n"
+                        "       [-S segment_bytes] [-b max_bytes] [-n max_segments] [-a max_age_seconds] [-e ring_entries]\n"
+                        "       [-r snapshot_file]\n", argv[0]);
+                closelog();
+                return -1;
+        }
+    }
+
     // Initialize mutexes without attributes (null)
     pthread_mutex_init(&file_mutex, NULL);
     pthread_mutex_init(&list_mutex, NULL);
@@ -447,8 +961,20 @@ int main(int argc, char* argv[]){
         return -1;
     }
 
+    // Setup optional local socket before forking so bind errors are reported to the caller
+    if(unix_path != NULL){
+        unix_fd = setup_unix_server(unix_path);
+        if(unix_fd == -1){
+            pthread_mutex_destroy(&file_mutex);
+            pthread_mutex_destroy(&list_mutex);
+            close(server_fd);
+            closelog();
+            return -1;
+        }
+    }
+
     // If argumnet '-d' is provided to program, listen for connections as a daemon
-    if ( (argc > 1) && (strcmp(argv[1], "-d") == 0)){
+    if (daemon_mode){
         pid_t pid;
 
         pid = fork();
@@ -456,6 +982,7 @@ int main(int argc, char* argv[]){
             err = errno;
             syslog(LOG_ERR, "Daemon process fork failed: %s\n", strerror(err));
             close(server_fd);
+            close_unix_server(unix_fd, unix_path);
             pthread_mutex_destroy(&file_mutex);
             pthread_mutex_destroy(&list_mutex);
             closelog();
@@ -468,6 +995,7 @@ int main(int argc, char* argv[]){
                 pthread_mutex_destroy(&file_mutex);
                 pthread_mutex_destroy(&list_mutex);
                 close(server_fd);
+                close_unix_server(unix_fd, unix_path);
                 closelog();
                 return -1;
             }
@@ -478,6 +1006,7 @@ int main(int argc, char* argv[]){
                 pthread_mutex_destroy(&file_mutex);
                 pthread_mutex_destroy(&list_mutex);
                 close(server_fd);
+                close_unix_server(unix_fd, unix_path);
                 closelog();
                 return -1;
             }
@@ -490,27 +1019,63 @@ int main(int argc, char* argv[]){
         }
     }
 
-#ifndef USE_AESD_CHAR_DEVICE
-    // Start stamper thread to add timestamps to output file every 10 seconds
-    pthread_t stamper_thread;
-    if( (pthread_create(&stamper_thread, NULL, stamper_handler, NULL)) != 0){
+    // Prepare storage after forking so backend state belongs to the serving process
+    if(storage->init(&storage_config) == -1){
         err = errno;
-        syslog(LOG_ERR, "Stamper thread creation failed: %s\n", strerror(err));
+        syslog(LOG_ERR, "Storage '%s' setup failed: %s\n", storage->name, strerror(err));
         pthread_mutex_destroy(&file_mutex);
         pthread_mutex_destroy(&list_mutex);
         close(server_fd);
+        close_unix_server(unix_fd, unix_path);
         closelog();
         return -1;
     }
-#endif
+
+    // Start stamper thread to add timestamps to output file every 10 seconds, not for driver style storage
+    if( (storage != &aesd_storage_device_ops) && (storage != &aesd_storage_ring_ops) &&
+            (storage != &aesd_storage_arena_ops) ){
+        if( (pthread_create(&stamper_thread, NULL, stamper_handler, NULL)) != 0){
+            err = errno;
+            syslog(LOG_ERR, "Stamper thread creation failed: %s\n", strerror(err));
+            storage->cleanup();
+            pthread_mutex_destroy(&file_mutex);
+            pthread_mutex_destroy(&list_mutex);
+            close(server_fd);
+            close_unix_server(unix_fd, unix_path);
+            closelog();
+            return -1;
+        }
+        stamper_started = 1;
+    }
 
     // Listen for incoming connections
     if( (listen(server_fd, BACKLOG)) == -1 ){
         err = errno;
         syslog(LOG_ERR, "Listening for incoming connections failed: %s\n", strerror(err));
+        active = 0;
+        if(stamper_started){
+            pthread_join(stamper_thread, NULL);
+        }
+        storage->cleanup();
+        pthread_mutex_destroy(&file_mutex);
+        pthread_mutex_destroy(&list_mutex);
+        close(server_fd);
+        close_unix_server(unix_fd, unix_path);
+        closelog();
+        return -1;
+    }
+    if( (unix_fd != -1) && (listen(unix_fd, BACKLOG) == -1) ){
+        err = errno;
+        syslog(LOG_ERR, "Listening on local socket failed: %s\n", strerror(err));
+        active = 0;
+        if(stamper_started){
+            pthread_join(stamper_thread, NULL);
+        }
+        storage->cleanup();
         pthread_mutex_destroy(&file_mutex);
         pthread_mutex_destroy(&list_mutex);
         close(server_fd);
+        close_unix_server(unix_fd, unix_path);
         closelog();
         return -1;
     }
@@ -521,8 +1086,8 @@ int main(int argc, char* argv[]){
         int client_fd;
         struct thread_data *new_client;
 
-        // Setting up client connection
-        client_fd = client_setup(server_fd);
+        // Setting up client connection from whichever listener is ready
+        client_fd = accept_next(server_fd, unix_fd);
         if(client_fd == -1){
             if(!active){
                 break; // Exit loop if signal was caught
@@ -574,26 +1139,20 @@ int main(int argc, char* argv[]){
     }
     pthread_mutex_unlock(&list_mutex);
 
-#ifndef USE_AESD_CHAR_DEVICE
     // Wait for stamper thread to finish
-    pthread_join(stamper_thread, NULL);
-#endif
+    if(stamper_started){
+        pthread_join(stamper_thread, NULL);
+    }
 
     pthread_mutex_destroy(&file_mutex);
     pthread_mutex_destroy(&list_mutex);
     
     close(server_fd);
+    close_unix_server(unix_fd, unix_path);
     syslog(LOG_DEBUG, "Server socket closed");
 
-#ifndef USE_AESD_CHAR_DEVICE
-    // Delete the output file
-    if(unlink(OUTPUT_FILE) == -1){
-        err = errno;
-        if(err != ENOENT){  // Ignore error if file doesn't exist
-            syslog(LOG_ERR, "Failed to delete output file: %s\n", strerror(err));
-        }
-    }
-#endif
+    // Release storage, file backed logs are deleted
+    storage->cleanup();
 
     closelog();
     return 0;
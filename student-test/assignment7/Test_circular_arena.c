@@ -0,0 +1,80 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-arena.h"
+
+#define TEST_ARENA_SIZE 32
+#define TEST_ARENA_ENTRIES 4
+
+static void add_string(struct aesd_circular_arena *arena, const char *str)
+{
+    TEST_ASSERT_TRUE(aesd_circular_arena_append(arena, str, strlen(str)));
+    aesd_circular_arena_commit(arena);
+}
+
+/**
+* Verifies entries written across the end of the arena read back as one stream, in at most two spans,
+* and the oldest entries are evicted when the arena bytes run out.
+*/
+void test_circular_arena_wraps_and_evicts()
+{
+    char data[TEST_ARENA_SIZE];
+    struct aesd_arena_entry entries[TEST_ARENA_ENTRIES];
+    struct aesd_circular_arena arena;
+    struct aesd_arena_span span[2];
+    char out[TEST_ARENA_SIZE + 1];
+    size_t fpos;
+
+    TEST_ASSERT_FALSE(aesd_circular_arena_init(&arena, data, 24, entries, TEST_ARENA_ENTRIES));
+    TEST_ASSERT_TRUE(aesd_circular_arena_init(&arena, data, TEST_ARENA_SIZE, entries, TEST_ARENA_ENTRIES));
+
+    add_string(&arena, "first entry\n");
+    add_string(&arena, "second entry\n");
+    TEST_ASSERT_EQUAL_size_t(25, aesd_circular_arena_calculate_size(&arena));
+
+    // Needs 12 more bytes, only 7 are free: the first entry goes and the new one wraps
+    add_string(&arena, "third entry\n");
+    TEST_ASSERT_EQUAL_size_t(2, aesd_circular_arena_entry_count(&arena));
+    TEST_ASSERT_EQUAL_size_t(25, aesd_circular_arena_calculate_size(&arena));
+    TEST_ASSERT_EQUAL_size_t(2, aesd_circular_arena_spans(&arena, 0, TEST_ARENA_SIZE, span));
+
+    memset(out, 0, sizeof(out));
+    TEST_ASSERT_EQUAL_size_t(25, aesd_circular_arena_read(&arena, 0, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("second entry\nthird entry\n", out);
+
+    TEST_ASSERT_TRUE(aesd_circular_arena_fpos_for_entry(&arena, 1, 2, &fpos));
+    TEST_ASSERT_EQUAL_size_t(15, fpos);
+    TEST_ASSERT_FALSE(aesd_circular_arena_fpos_for_entry(&arena, 2, 0, &fpos));
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_arena_read(&arena, 25, out, sizeof(out)));
+}
+
+/**
+* Verifies an entry built from several appends, eviction by entry slots and refusal of a pending
+* entry larger than the arena.
+*/
+void test_circular_arena_pending_entry()
+{
+    char data[TEST_ARENA_SIZE];
+    struct aesd_arena_entry entries[TEST_ARENA_ENTRIES];
+    struct aesd_circular_arena arena;
+    char big[TEST_ARENA_SIZE + 1];
+    char out[TEST_ARENA_SIZE];
+    int i;
+
+    aesd_circular_arena_init(&arena, data, TEST_ARENA_SIZE, entries, TEST_ARENA_ENTRIES);
+    for(i = 0; i < TEST_ARENA_ENTRIES + 2; i++){
+        add_string(&arena, "x\n");
+    }
+    TEST_ASSERT_EQUAL_size_t(TEST_ARENA_ENTRIES, aesd_circular_arena_entry_count(&arena));
+
+    TEST_ASSERT_TRUE(aesd_circular_arena_append(&arena, "par", 3));
+    TEST_ASSERT_TRUE(aesd_circular_arena_append(&arena, "tial\n", 5));
+    TEST_ASSERT_EQUAL_size_t(2 * TEST_ARENA_ENTRIES, aesd_circular_arena_calculate_size(&arena));
+    aesd_circular_arena_commit(&arena);
+    TEST_ASSERT_EQUAL_size_t(6, aesd_circular_arena_read(&arena, 2 * (TEST_ARENA_ENTRIES - 1), out, 6));
+    TEST_ASSERT_EQUAL_MEMORY("partia", out, 6);
+
+    memset(big, 'b', sizeof(big));
+    TEST_ASSERT_FALSE(aesd_circular_arena_append(&arena, big, sizeof(big)));
+    TEST_ASSERT_EQUAL_size_t(TEST_ARENA_ENTRIES, aesd_circular_arena_entry_count(&arena));
+}
@@ -0,0 +1,181 @@
+#include "unity.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-atomic.h"
+
+#define STRESS_CAPACITY 64
+#define STRESS_MAX_ENTRY 64
+#define STRESS_ENTRIES_PER_PRODUCER 100000
+#define STRESS_READERS 3
+#define STRESS_PRODUCERS 3
+
+/**
+* Stress tests for the lock-free ring.  Build this suite with -fsanitize=thread to check the
+* protocol for data races; without it they still verify no reader ever sees a torn entry.
+* Every payload is derived from a value stored in its first bytes so readers can validate it.
+*/
+struct stress_state {
+    struct aesd_atomic_ring *ring;
+    int producers;
+    _Atomic int producers_done;
+    _Atomic uint64_t bad_entries;
+    _Atomic uint64_t entries_read;
+};
+
+static size_t fill_payload(char *buf, uint64_t value)
+{
+    size_t len = sizeof(value) + (value % (STRESS_MAX_ENTRY - sizeof(value) + 1));
+    size_t i;
+
+    memcpy(buf, &value, sizeof(value));
+    for(i = sizeof(value); i < len; i++){
+        buf[i] = (char)(value * 31 + i);
+    }
+    return len;
+}
+
+static bool payload_valid(const char *buf, size_t size)
+{
+    char expected[STRESS_MAX_ENTRY];
+    uint64_t value;
+
+    if(size < sizeof(value)){
+        return false;
+    }
+    memcpy(&value, buf, sizeof(value));
+    return (fill_payload(expected, value) == size) && (memcmp(expected, buf, size) == 0);
+}
+
+static void *stress_producer(void *arg)
+{
+    struct stress_state *state = arg;
+    char buf[STRESS_MAX_ENTRY];
+    uint64_t i;
+
+    for(i = 0; i < STRESS_ENTRIES_PER_PRODUCER; i++){
+        aesd_atomic_ring_add(state->ring, buf, fill_payload(buf, i), NULL);
+    }
+    atomic_fetch_add(&state->producers_done, 1);
+    return NULL;
+}
+
+static void *stress_reader(void *arg)
+{
+    struct stress_state *state = arg;
+    struct aesd_atomic_cursor cursor;
+    char buf[STRESS_MAX_ENTRY];
+    size_t size;
+    uint64_t last = 0;
+    bool single = (state->producers == 1);
+
+    aesd_atomic_cursor_init(state->ring, &cursor);
+    while(atomic_load(&state->producers_done) < state->producers){
+        if(aesd_atomic_ring_next(state->ring, &cursor, buf, sizeof(buf), &size) != AESD_ATOMIC_OK){
+            continue;
+        }
+        atomic_fetch_add(&state->entries_read, 1);
+        if(!payload_valid(buf, size)){
+            atomic_fetch_add(&state->bad_entries, 1);
+            continue;
+        }
+        // A single producer writes increasing values, a reader must never go backwards
+        if(single){
+            uint64_t value;
+            memcpy(&value, buf, sizeof(value));
+            if( (last != 0) && (value <= last) ){
+                atomic_fetch_add(&state->bad_entries, 1);
+            }
+            last = value;
+        }
+    }
+    return NULL;
+}
+
+static void run_stress(enum aesd_atomic_mode mode, int producers)
+{
+    struct stress_state state;
+    pthread_t producer_threads[STRESS_PRODUCERS], reader_threads[STRESS_READERS];
+    struct aesd_atomic_cursor cursor;
+    char buf[STRESS_MAX_ENTRY];
+    size_t size;
+    int i, held = 0;
+
+    state.ring = aesd_atomic_ring_create(STRESS_CAPACITY, STRESS_MAX_ENTRY, mode);
+    TEST_ASSERT_NOT_NULL(state.ring);
+    state.producers = producers;
+    atomic_init(&state.producers_done, 0);
+    atomic_init(&state.bad_entries, 0);
+    atomic_init(&state.entries_read, 0);
+
+    for(i = 0; i < STRESS_READERS; i++){
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&reader_threads[i], NULL, stress_reader, &state));
+    }
+    for(i = 0; i < producers; i++){
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&producer_threads[i], NULL, stress_producer, &state));
+    }
+    for(i = 0; i < producers; i++){
+        pthread_join(producer_threads[i], NULL);
+    }
+    for(i = 0; i < STRESS_READERS; i++){
+        pthread_join(reader_threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL_UINT64_MESSAGE(0, atomic_load(&state.bad_entries), "Readers saw torn or out of order entries");
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)producers * STRESS_ENTRIES_PER_PRODUCER, aesd_atomic_ring_head(state.ring));
+
+    // Once producers are quiet the last capacity entries are all readable
+    aesd_atomic_cursor_init(state.ring, &cursor);
+    while(aesd_atomic_ring_next(state.ring, &cursor, buf, sizeof(buf), &size) == AESD_ATOMIC_OK){
+        TEST_ASSERT_TRUE(payload_valid(buf, size));
+        held++;
+    }
+    TEST_ASSERT_EQUAL_INT(STRESS_CAPACITY, held);
+    aesd_atomic_ring_destroy(state.ring);
+}
+
+void test_circular_atomic_single_producer_stress()
+{
+    run_stress(AESD_ATOMIC_SINGLE_PRODUCER, 1);
+}
+
+void test_circular_atomic_multi_producer_stress()
+{
+    run_stress(AESD_ATOMIC_MULTI_PRODUCER, STRESS_PRODUCERS);
+}
+
+/**
+* Verifies the sequence checks on a quiet ring: entries not written yet, overwritten entries and a
+* too small reader buffer.
+*/
+void test_circular_atomic_sequence_checks()
+{
+    struct aesd_atomic_ring *ring = aesd_atomic_ring_create(4, 16, AESD_ATOMIC_SINGLE_PRODUCER);
+    struct aesd_atomic_cursor cursor;
+    char buf[16];
+    size_t size;
+    uint64_t seq;
+    int i;
+
+    TEST_ASSERT_NULL(aesd_atomic_ring_create(6, 16, AESD_ATOMIC_SINGLE_PRODUCER));
+    TEST_ASSERT_NOT_NULL(ring);
+    TEST_ASSERT_FALSE(aesd_atomic_ring_add(ring, buf, 17, NULL));
+    TEST_ASSERT_EQUAL_INT(AESD_ATOMIC_AGAIN, aesd_atomic_ring_read(ring, 0, buf, sizeof(buf), &size));
+
+    aesd_atomic_cursor_init(ring, &cursor);
+    for(i = 0; i < 6; i++){
+        TEST_ASSERT_TRUE(aesd_atomic_ring_add(ring, "entry", 5, &seq));
+    }
+    TEST_ASSERT_EQUAL_UINT64(5, seq);
+    TEST_ASSERT_EQUAL_INT(AESD_ATOMIC_OVERWRITTEN, aesd_atomic_ring_read(ring, 1, buf, sizeof(buf), &size));
+    TEST_ASSERT_EQUAL_INT(AESD_ATOMIC_TRUNCATED, aesd_atomic_ring_read(ring, 2, buf, 4, &size));
+    TEST_ASSERT_EQUAL_size_t(5, size);
+
+    // The cursor started at 0, entries 0 and 1 were lost
+    TEST_ASSERT_EQUAL_INT(AESD_ATOMIC_OK, aesd_atomic_ring_next(ring, &cursor, buf, sizeof(buf), &size));
+    TEST_ASSERT_EQUAL_UINT64(2, cursor.lost);
+    TEST_ASSERT_EQUAL_UINT64(3, cursor.next);
+    TEST_ASSERT_EQUAL_MEMORY("entry", buf, 5);
+    aesd_atomic_ring_destroy(ring);
+}
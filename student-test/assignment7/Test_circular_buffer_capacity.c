@@ -0,0 +1,105 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+#define TEST_CAPACITY 32768
+
+/**
+* Fills each entry with a line holding its write number so offsets can be checked against a
+* concatenation computed here.  Strings live in a table owned by the test.
+*/
+static char lines[TEST_CAPACITY * 2][16];
+
+static void add_line(struct aesd_circular_buffer *buffer, unsigned int number)
+{
+    struct aesd_buffer_entry entry;
+    snprintf(lines[number], sizeof(lines[number]), "line %u\n", number);
+    entry.buffptr = lines[number];
+    entry.size = strlen(lines[number]);
+    aesd_circular_buffer_add_entry(buffer, &entry);
+}
+
+/**
+* Verifies a buffer set up with caller storage of TEST_CAPACITY entries keeps the most recent
+* TEST_CAPACITY writes and finds every one of them by offset after wrapping.
+*/
+void test_circular_buffer_large_capacity()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry *storage = malloc(TEST_CAPACITY * sizeof(struct aesd_buffer_entry));
+    struct aesd_buffer_entry *entry;
+    size_t offset, entry_offset, fpos;
+    unsigned int number;
+
+    TEST_ASSERT_NOT_NULL(storage);
+    TEST_ASSERT_TRUE_MESSAGE(aesd_circular_buffer_init_capacity(&buffer, storage, TEST_CAPACITY),
+            "A power of two capacity should be accepted");
+
+    for(number = 0; number < TEST_CAPACITY; number++){
+        add_line(&buffer, number);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(buffer.full, "Buffer should be full after capacity writes");
+    TEST_ASSERT_EQUAL_UINT32(TEST_CAPACITY, aesd_circular_buffer_entry_count(&buffer));
+
+    // Wrap halfway around, the oldest half is overwritten
+    for(; number < TEST_CAPACITY + (TEST_CAPACITY / 2); number++){
+        add_line(&buffer, number);
+    }
+    TEST_ASSERT_EQUAL_UINT32(TEST_CAPACITY, aesd_circular_buffer_entry_count(&buffer));
+
+    offset = 0;
+    for(number = TEST_CAPACITY / 2; number < TEST_CAPACITY + (TEST_CAPACITY / 2); number++){
+        entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, offset, &entry_offset);
+        TEST_ASSERT_NOT_NULL(entry);
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(lines[number], entry->buffptr, "Entry found at offset is not the expected write");
+        TEST_ASSERT_EQUAL_size_t(0, entry_offset);
+
+        TEST_ASSERT_TRUE(aesd_circular_buffer_fpos_for_entry(&buffer, number - (TEST_CAPACITY / 2), 1, &fpos));
+        TEST_ASSERT_EQUAL_size_t(offset + 1, fpos);
+        offset += entry->size;
+    }
+    TEST_ASSERT_EQUAL_size_t(offset, aesd_circular_buffer_calculate_size(&buffer));
+    TEST_ASSERT_NULL(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, offset, &entry_offset));
+
+    free(storage);
+}
+
+/**
+* Verifies capacities that are not a power of two are refused and the default buffer still keeps
+* AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED entries, visiting every slot with AESD_CIRCULAR_BUFFER_FOREACH.
+*/
+void test_circular_buffer_default_capacity()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry storage[12];
+    struct aesd_buffer_entry *entry;
+    size_t entry_offset;
+    uint32_t index;
+    unsigned int number, used = 0;
+
+    TEST_ASSERT_FALSE(aesd_circular_buffer_init_capacity(&buffer, storage, 12));
+    TEST_ASSERT_FALSE(aesd_circular_buffer_init_capacity(&buffer, storage, 0));
+
+    aesd_circular_buffer_init(&buffer);
+    for(number = 0; number < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED + 3; number++){
+        add_line(&buffer, number);
+    }
+    TEST_ASSERT_TRUE(buffer.full);
+    TEST_ASSERT_EQUAL_UINT32(AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, aesd_circular_buffer_entry_count(&buffer));
+
+    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &entry_offset);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(lines[3], entry->buffptr, "Oldest three writes should have been overwritten");
+
+    // Overwritten entries are cleared, FOREACH sees exactly the live ones
+    AESD_CIRCULAR_BUFFER_FOREACH(entry, &buffer, index){
+        if(entry->buffptr != NULL){
+            used++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS, index);
+    TEST_ASSERT_EQUAL_UINT32(AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, used);
+}
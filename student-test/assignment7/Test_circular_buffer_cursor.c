@@ -0,0 +1,209 @@
+#include "unity.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+#define CURSOR_CAPACITY 8
+#define CURSOR_LINES 200000
+#define CURSOR_LINE_LEN 9
+#define CURSOR_READ_LEN 13
+#define CURSOR_RUN_LEN 4096
+
+static const char *strings[] = { "write1\n", "write2\n", "write3\n", "write4\n", "write5\n", "write6\n" };
+
+static void add_string(struct aesd_circular_buffer *buffer, size_t i)
+{
+    struct aesd_buffer_entry entry;
+
+    entry.buffptr = strings[i];
+    entry.size = strlen(strings[i]);
+    aesd_circular_buffer_add_entry(buffer, &entry);
+}
+
+static size_t gather(const struct iovec *iov, size_t nr_iov, char *out)
+{
+    size_t i, len = 0;
+
+    for(i = 0; i < nr_iov; i++){
+        memcpy(out + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    return len;
+}
+
+/**
+* Verifies a read resumed from a (seq, offset) cursor continues with the next byte even after older
+* entries were evicted, moves past an entry read to its end and stops once its own entry is evicted.
+*/
+void test_circular_buffer_fill_iovec_seq()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry storage[4];
+    struct iovec iov[4];
+    char out[64];
+    uint64_t seq, first;
+    size_t fpos, offset, nr_iov, bytes, i;
+
+    aesd_circular_buffer_init_capacity(&buffer, storage, 4);
+    for(i = 0; i < 4; i++){
+        add_string(&buffer, i);
+    }
+    first = aesd_circular_buffer_find_entry_for_seq(&buffer, 0, &fpos)->seq;
+
+    // First batch: 6 bytes from the middle of write2
+    seq = first + 1;
+    offset = 3;
+    nr_iov = aesd_circular_buffer_fill_iovec_seq(&buffer, &seq, &offset, 6, iov, 4, &bytes);
+    TEST_ASSERT_EQUAL_size_t(2, nr_iov);
+    TEST_ASSERT_EQUAL_size_t(6, bytes);
+    TEST_ASSERT_EQUAL_UINT64(first + 1, seq);
+    TEST_ASSERT_EQUAL_size_t(3, offset);
+    TEST_ASSERT_EQUAL_MEMORY("te2\nwr", out, gather(iov, nr_iov, out));
+
+    // write1 and write2 are evicted before the next batch, which still starts at "ite3"
+    add_string(&buffer, 4);
+    add_string(&buffer, 5);
+    seq = first + 2;
+    offset = 2;
+    nr_iov = aesd_circular_buffer_fill_iovec_seq(&buffer, &seq, &offset, SIZE_MAX, iov, 4, &bytes);
+    TEST_ASSERT_EQUAL_size_t(4, nr_iov);
+    TEST_ASSERT_EQUAL_size_t(26, bytes);
+    TEST_ASSERT_EQUAL_MEMORY("ite3\nwrite4\nwrite5\nwrite6\n", out, gather(iov, nr_iov, out));
+
+    // A cursor at the end of write3 starts at write4
+    seq = first + 2;
+    offset = 7;
+    nr_iov = aesd_circular_buffer_fill_iovec_seq(&buffer, &seq, &offset, 3, iov, 4, &bytes);
+    TEST_ASSERT_EQUAL_size_t(1, nr_iov);
+    TEST_ASSERT_EQUAL_UINT64(first + 3, seq);
+    TEST_ASSERT_EQUAL_size_t(0, offset);
+    TEST_ASSERT_EQUAL_MEMORY("wri", iov[0].iov_base, 3);
+
+    // Evicted and not yet written entries describe nothing
+    seq = first + 1;
+    offset = 0;
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_fill_iovec_seq(&buffer, &seq, &offset, SIZE_MAX, iov, 4, &bytes));
+    TEST_ASSERT_EQUAL_size_t(0, bytes);
+    seq = first + 5;
+    offset = 7;
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_fill_iovec_seq(&buffer, &seq, &offset, SIZE_MAX, iov, 4, &bytes));
+    seq = first + 6;
+    offset = 0;
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_fill_iovec_seq(&buffer, &seq, &offset, SIZE_MAX, iov, 4, &bytes));
+}
+
+struct cursor_state {
+    pthread_mutex_t lock;
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry storage[CURSOR_CAPACITY];
+    char *lines;
+    atomic_bool done;
+};
+
+static void *cursor_writer(void *arg)
+{
+    struct cursor_state *state = arg;
+    struct aesd_buffer_entry entry;
+    size_t i;
+
+    for(i = 0; i < CURSOR_LINES; i++){
+        entry.buffptr = &state->lines[i * CURSOR_LINE_LEN];
+        entry.size = CURSOR_LINE_LEN;
+        pthread_mutex_lock(&state->lock);
+        aesd_circular_buffer_add_entry(&state->buffer, &entry);
+        pthread_mutex_unlock(&state->lock);
+    }
+    atomic_store(&state->done, true);
+    return NULL;
+}
+
+/* The run must be whole lines numbered one after the other, then maybe the start of the next one */
+static bool cursor_run_valid(const char *run, size_t len)
+{
+    char expected[CURSOR_LINE_LEN + 1];
+    unsigned long line;
+    size_t pos;
+
+    if(len < CURSOR_LINE_LEN){
+        return true;
+    }
+    line = strtoul(run, NULL, 10);
+    for(pos = 0; pos < len; pos += CURSOR_LINE_LEN, line++){
+        size_t piece = (len - pos < CURSOR_LINE_LEN) ? (len - pos) : CURSOR_LINE_LEN;
+        snprintf(expected, sizeof(expected), "%08lu\n", line);
+        if(memcmp(expected, run + pos, piece) != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* Reader and evicting writer the way the driver runs them: each batch is described under the lock and
+* copied out after dropping it, payloads are never freed while a reader may hold them.  Every run of
+* batches must be one contiguous stretch of the numbered lines written, however many were evicted meanwhile.
+*/
+void test_circular_buffer_cursor_concurrent_evict()
+{
+    struct cursor_state state;
+    struct aesd_buffer_entry *entry;
+    struct iovec iov[3];
+    static char run[CURSOR_RUN_LEN];
+    pthread_t writer;
+    uint64_t seq, first_seq, runs = 0;
+    size_t i, fpos, offset, first_offset, nr_iov, bytes, len;
+    bool started;
+
+    pthread_mutex_init(&state.lock, NULL);
+    aesd_circular_buffer_init_capacity(&state.buffer, state.storage, CURSOR_CAPACITY);
+    state.lines = malloc((size_t)CURSOR_LINES * CURSOR_LINE_LEN + 1);
+    TEST_ASSERT_NOT_NULL(state.lines);
+    for(i = 0; i < CURSOR_LINES; i++){
+        snprintf(&state.lines[i * CURSOR_LINE_LEN], CURSOR_LINE_LEN + 1, "%08zu\n", i);
+    }
+    atomic_init(&state.done, false);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&writer, NULL, cursor_writer, &state));
+    while(!atomic_load(&state.done)){
+        // Start each run at the oldest entry, then follow the cursor batch by batch
+        len = 0;
+        started = false;
+        seq = 0;
+        offset = 0;
+        while(len + CURSOR_READ_LEN <= sizeof(run)){
+            pthread_mutex_lock(&state.lock);
+            if(!started){
+                entry = aesd_circular_buffer_find_entry_for_seq(&state.buffer, 0, &fpos);
+                seq = (entry != NULL) ? entry->seq : state.buffer.next_seq;
+            }
+            first_seq = seq;
+            first_offset = offset;
+            nr_iov = aesd_circular_buffer_fill_iovec_seq(&state.buffer, &first_seq, &first_offset,
+                    CURSOR_READ_LEN, iov, 3, &bytes);
+            pthread_mutex_unlock(&state.lock);
+            started = true;
+            if(nr_iov == 0){
+                // Caught up with the writer, or the cursor's entry was evicted
+                break;
+            }
+            for(i = 0; i < nr_iov; i++){
+                memcpy(run + len, iov[i].iov_base, iov[i].iov_len);
+                len += iov[i].iov_len;
+                seq = first_seq + i;
+                offset = (i == 0 ? first_offset : 0) + iov[i].iov_len;
+            }
+        }
+        runs++;
+        TEST_ASSERT_TRUE_MESSAGE(cursor_run_valid(run, len), "Read skipped or repeated bytes across batches");
+    }
+    pthread_join(writer, NULL);
+
+    TEST_ASSERT_TRUE(runs > 0);
+    free(state.lines);
+    pthread_mutex_destroy(&state.lock);
+}
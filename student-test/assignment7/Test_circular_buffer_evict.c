@@ -0,0 +1,110 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+static const char big[] = "0123456789012345678901234567890123456789\n";
+static const char small[] = "abc\n";
+
+static void fill_entry(struct aesd_buffer_entry *entry, const char *str)
+{
+    entry->buffptr = str;
+    entry->size = strlen(str);
+}
+
+/**
+* Verifies adding entries under a byte budget evicts the oldest entries, returns them to the caller
+* oldest first and keeps the total size within the budget.
+*/
+void test_circular_buffer_byte_budget()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry, evicted[4];
+    size_t nr_evicted;
+    int i;
+
+    aesd_circular_buffer_init(&buffer);
+    aesd_circular_buffer_set_limits(&buffer, 3 * (sizeof(small) - 1) + (sizeof(big) - 1), 0);
+
+    fill_entry(&entry, big);
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_add_entry_evict(&buffer, &entry, evicted, 4));
+    fill_entry(&entry, small);
+    for(i = 0; i < 3; i++){
+        TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_add_entry_evict(&buffer, &entry, evicted, 4));
+    }
+
+    // One more small entry goes over budget, the big one has to make room
+    nr_evicted = aesd_circular_buffer_add_entry_evict(&buffer, &entry, evicted, 4);
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(1, nr_evicted, "Oldest entry should be evicted to stay within the byte budget");
+    TEST_ASSERT_EQUAL_PTR(big, evicted[0].buffptr);
+    TEST_ASSERT_EQUAL_size_t(4 * (sizeof(small) - 1), aesd_circular_buffer_calculate_size(&buffer));
+    TEST_ASSERT_EQUAL_size_t(4, aesd_circular_buffer_entry_count(&buffer));
+
+    // A second big entry needs the room of everything else, all of it comes back in one batch
+    fill_entry(&entry, big);
+    aesd_circular_buffer_add_entry_evict(&buffer, &entry, evicted, 4);
+    nr_evicted = aesd_circular_buffer_add_entry_evict(&buffer, &entry, evicted, 4);
+    TEST_ASSERT_EQUAL_size_t(4, nr_evicted);
+    TEST_ASSERT_EQUAL_PTR(small, evicted[2].buffptr);
+    TEST_ASSERT_EQUAL_PTR(big, evicted[3].buffptr);
+    TEST_ASSERT_EQUAL_size_t(1, aesd_circular_buffer_entry_count(&buffer));
+    TEST_ASSERT_TRUE(aesd_circular_buffer_calculate_size(&buffer) <= buffer.max_bytes);
+}
+
+/**
+* Verifies an entry count cap below the capacity, eviction left over by a short evicted array and the
+* newest entry being kept even when it alone exceeds the budget.
+*/
+void test_circular_buffer_entry_cap_and_trim()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry, evicted[2];
+    size_t entry_offset;
+    int i;
+
+    aesd_circular_buffer_init(&buffer);
+    aesd_circular_buffer_set_limits(&buffer, 0, 3);
+    fill_entry(&entry, small);
+    for(i = 0; i < 6; i++){
+        aesd_circular_buffer_add_entry(&buffer, &entry);
+    }
+    TEST_ASSERT_EQUAL_size_t(3, aesd_circular_buffer_entry_count(&buffer));
+
+    // Lowering the budget leaves the buffer over it until evict is called
+    aesd_circular_buffer_set_limits(&buffer, 1, 0);
+    TEST_ASSERT_EQUAL_size_t(2, aesd_circular_buffer_evict(&buffer, evicted, 2));
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_evict(&buffer, evicted, 2));
+    TEST_ASSERT_EQUAL_size_t(1, aesd_circular_buffer_entry_count(&buffer));
+
+    fill_entry(&entry, big);
+    TEST_ASSERT_EQUAL_size_t(1, aesd_circular_buffer_add_entry_evict(&buffer, &entry, evicted, 2));
+    TEST_ASSERT_EQUAL_size_t(sizeof(big) - 1, aesd_circular_buffer_calculate_size(&buffer));
+    TEST_ASSERT_EQUAL_PTR(big, aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &entry_offset)->buffptr);
+}
+
+/**
+* Verifies evicting the oldest entries under memory pressure ignores the limits, returns entries oldest
+* first and keeps the newest one.
+*/
+void test_circular_buffer_evict_oldest()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry, evicted[4];
+    size_t entry_offset;
+
+    aesd_circular_buffer_init(&buffer);
+    fill_entry(&entry, big);
+    aesd_circular_buffer_add_entry(&buffer, &entry);
+    fill_entry(&entry, small);
+    aesd_circular_buffer_add_entry(&buffer, &entry);
+    aesd_circular_buffer_add_entry(&buffer, &entry);
+
+    TEST_ASSERT_EQUAL_size_t(1, aesd_circular_buffer_evict_oldest(&buffer, evicted, 1));
+    TEST_ASSERT_EQUAL_PTR(big, evicted[0].buffptr);
+    TEST_ASSERT_EQUAL_size_t(2 * (sizeof(small) - 1), aesd_circular_buffer_calculate_size(&buffer));
+
+    TEST_ASSERT_EQUAL_size_t(1, aesd_circular_buffer_evict_oldest(&buffer, evicted, 4));
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_evict_oldest(&buffer, evicted, 4));
+    TEST_ASSERT_EQUAL_size_t(1, aesd_circular_buffer_entry_count(&buffer));
+    TEST_ASSERT_EQUAL_UINT64(2, aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &entry_offset)->seq);
+}
@@ -0,0 +1,79 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+static const char *strings[] = { "write1\n", "write2\n", "write3\n", "write4\n", "write5\n", "write6\n" };
+
+static void fill_entries(struct aesd_buffer_entry *entries, size_t count)
+{
+    size_t i;
+    for(i = 0; i < count; i++){
+        entries[i].buffptr = strings[i];
+        entries[i].size = strlen(strings[i]);
+    }
+}
+
+/**
+* Verifies a batch insert reports displaced entries in one array and stops before losing any when
+* that array is full.
+*/
+void test_circular_buffer_add_entries()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry storage[4], entries[6], evicted[1];
+    size_t nr_evicted, added;
+
+    aesd_circular_buffer_init_capacity(&buffer, storage, 4);
+    fill_entries(entries, 6);
+
+    added = aesd_circular_buffer_add_entries(&buffer, entries, 6, evicted, 1, &nr_evicted);
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(5, added, "Sixth entry would need a second evicted slot");
+    TEST_ASSERT_EQUAL_size_t(1, nr_evicted);
+    TEST_ASSERT_EQUAL_PTR(strings[0], evicted[0].buffptr);
+
+    added = aesd_circular_buffer_add_entries(&buffer, &entries[5], 1, evicted, 1, &nr_evicted);
+    TEST_ASSERT_EQUAL_size_t(1, added);
+    TEST_ASSERT_EQUAL_PTR(strings[1], evicted[0].buffptr);
+    TEST_ASSERT_EQUAL_size_t(4, aesd_circular_buffer_entry_count(&buffer));
+
+    added = aesd_circular_buffer_add_entries(&buffer, entries, 6, NULL, 0, &nr_evicted);
+    TEST_ASSERT_EQUAL_size_t(6, added);
+    TEST_ASSERT_EQUAL_size_t(6, nr_evicted);
+}
+
+/**
+* Verifies the iovec export covers a byte range from the middle of an entry across the wrap point,
+* honours the length and element limits and describes nothing past the end.
+*/
+void test_circular_buffer_fill_iovec()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry storage[4], entries[6];
+    struct iovec iov[4];
+    size_t nr_evicted, nr_iov, bytes;
+
+    aesd_circular_buffer_init_capacity(&buffer, storage, 4);
+    fill_entries(entries, 6);
+    aesd_circular_buffer_add_entries(&buffer, entries, 6, NULL, 0, &nr_evicted);
+
+    // Buffer holds write3..write6, starting in the middle of write3
+    nr_iov = aesd_circular_buffer_fill_iovec(&buffer, 5, SIZE_MAX, iov, 4, &bytes);
+    TEST_ASSERT_EQUAL_size_t(4, nr_iov);
+    TEST_ASSERT_EQUAL_size_t(23, bytes);
+    TEST_ASSERT_EQUAL_MEMORY("3\n", iov[0].iov_base, 2);
+    TEST_ASSERT_EQUAL_PTR(strings[5], iov[3].iov_base);
+
+    nr_iov = aesd_circular_buffer_fill_iovec(&buffer, 5, 10, iov, 4, &bytes);
+    TEST_ASSERT_EQUAL_size_t(3, nr_iov);
+    TEST_ASSERT_EQUAL_size_t(10, bytes);
+    TEST_ASSERT_EQUAL_size_t(1, iov[2].iov_len);
+
+    nr_iov = aesd_circular_buffer_fill_iovec(&buffer, 0, SIZE_MAX, iov, 2, &bytes);
+    TEST_ASSERT_EQUAL_size_t(2, nr_iov);
+    TEST_ASSERT_EQUAL_size_t(14, bytes);
+
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_fill_iovec(&buffer, 28, SIZE_MAX, iov, 4, &bytes));
+    TEST_ASSERT_EQUAL_size_t(0, bytes);
+}
@@ -0,0 +1,112 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+static const char *strings[] = { "write1\n", "write2\n", "write3\n", "write4\n", "write5\n", "write6\n" };
+
+/* Snapshot image written the way a file would be: header, entry table, then the payload from fill_iovec */
+static char *make_image(struct aesd_circular_buffer *buffer, size_t *image_len)
+{
+    struct aesd_snapshot_header header;
+    struct aesd_snapshot_entry table[AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS];
+    struct iovec iov[AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS];
+    size_t count, nr_iov, bytes, i;
+    char *image, *pos;
+
+    count = aesd_circular_buffer_snapshot(buffer, &header, table, AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS);
+    *image_len = sizeof(header) + (count * sizeof(table[0])) + header.payload_size;
+    image = malloc(*image_len);
+    TEST_ASSERT_NOT_NULL(image);
+
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), table, count * sizeof(table[0]));
+    pos = image + sizeof(header) + (count * sizeof(table[0]));
+    nr_iov = aesd_circular_buffer_fill_iovec(buffer, 0, SIZE_MAX, iov, AESD_CIRCULAR_BUFFER_DEFAULT_SLOTS, &bytes);
+    TEST_ASSERT_EQUAL_size_t(header.payload_size, bytes);
+    for(i = 0; i < nr_iov; i++){
+        memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    return image;
+}
+
+/**
+* Verifies a snapshot of a wrapped buffer restores into a smaller buffer in place, keeping the newest
+* entries with their sequence numbers and timestamps, and that new entries continue the sequence.
+*/
+void test_circular_buffer_snapshot_restore()
+{
+    struct aesd_circular_buffer buffer, restored;
+    struct aesd_buffer_entry storage[4], small_storage[2], entry;
+    size_t image_len, entry_offset, i;
+    char *image;
+
+    aesd_circular_buffer_init_capacity(&buffer, storage, 4);
+    for(i = 0; i < 6; i++){
+        entry.buffptr = strings[i];
+        entry.size = strlen(strings[i]);
+        aesd_circular_buffer_add_entry(&buffer, &entry);
+    }
+    image = make_image(&buffer, &image_len);
+
+    aesd_circular_buffer_init_capacity(&restored, small_storage, 2);
+    TEST_ASSERT_TRUE(aesd_circular_buffer_restore(&restored, image, image_len));
+    TEST_ASSERT_EQUAL_size_t(2, aesd_circular_buffer_entry_count(&restored));
+    TEST_ASSERT_EQUAL_size_t(14, aesd_circular_buffer_calculate_size(&restored));
+    TEST_ASSERT_TRUE(restored.full);
+
+    // Entries point into the image instead of being copied
+    entry = *aesd_circular_buffer_find_entry_offset_for_fpos(&restored, 0, &entry_offset);
+    TEST_ASSERT_TRUE( (entry.buffptr > image) && (entry.buffptr < image + image_len) );
+    TEST_ASSERT_EQUAL_MEMORY("write5\n", entry.buffptr, entry.size);
+    TEST_ASSERT_EQUAL_UINT64(4, entry.seq);
+    TEST_ASSERT_EQUAL_UINT64(buffer.entry[(buffer.out_offs + 2) & buffer.mask].timestamp, entry.timestamp);
+    TEST_ASSERT_EQUAL_MEMORY("write6\n", aesd_circular_buffer_find_entry_for_seq(&restored, 5, &entry_offset)->buffptr, 7);
+
+    TEST_ASSERT_FALSE_MESSAGE(aesd_circular_buffer_restore(&restored, image, image_len), "Only empty buffers restore");
+    entry.buffptr = strings[0];
+    entry.size = strlen(strings[0]);
+    aesd_circular_buffer_add_entry(&restored, &entry);
+    TEST_ASSERT_EQUAL_UINT64(6, restored.entry[(restored.out_offs + 1) & restored.mask].seq);
+    free(image);
+}
+
+/**
+* Verifies truncated and corrupted images are rejected without touching the buffer.
+*/
+void test_circular_buffer_restore_invalid()
+{
+    struct aesd_circular_buffer buffer, restored;
+    struct aesd_buffer_entry entry;
+    struct aesd_snapshot_header *header;
+    size_t image_len;
+    char *image;
+
+    aesd_circular_buffer_init(&buffer);
+    entry.buffptr = strings[0];
+    entry.size = strlen(strings[0]);
+    aesd_circular_buffer_add_entry(&buffer, &entry);
+    image = make_image(&buffer, &image_len);
+    header = (struct aesd_snapshot_header *)image;
+
+    aesd_circular_buffer_init(&restored);
+    TEST_ASSERT_FALSE(aesd_circular_buffer_restore(&restored, image, image_len - 1));
+    TEST_ASSERT_FALSE(aesd_circular_buffer_restore(&restored, image, sizeof(*header) - 1));
+    header->payload_size++;
+    TEST_ASSERT_FALSE(aesd_circular_buffer_restore(&restored, image, image_len));
+    header->payload_size--;
+    header->nr_entries = UINT32_MAX;
+    TEST_ASSERT_FALSE(aesd_circular_buffer_restore(&restored, image, image_len));
+    header->nr_entries = 1;
+    header->magic++;
+    TEST_ASSERT_FALSE(aesd_circular_buffer_restore(&restored, image, image_len));
+    TEST_ASSERT_EQUAL_size_t(0, aesd_circular_buffer_entry_count(&restored));
+
+    header->magic--;
+    TEST_ASSERT_TRUE(aesd_circular_buffer_restore(&restored, image, image_len));
+    TEST_ASSERT_EQUAL_size_t(7, aesd_circular_buffer_calculate_size(&restored));
+    free(image);
+}
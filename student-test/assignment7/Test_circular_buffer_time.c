@@ -0,0 +1,80 @@
+#include "unity.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+static void add_string(struct aesd_circular_buffer *buffer, const char *str)
+{
+    struct aesd_buffer_entry entry;
+    entry.buffptr = str;
+    entry.size = strlen(str);
+    aesd_circular_buffer_add_entry(buffer, &entry);
+}
+
+/**
+* Verifies entries get consecutive sequence numbers and non-decreasing timestamps, and that a lookup
+* by sequence number returns the entry and its fpos, after the oldest entries were overwritten.
+*/
+void test_circular_buffer_find_by_seq()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry *entry;
+    size_t fpos;
+    int i;
+
+    aesd_circular_buffer_init(&buffer);
+    for(i = 0; i < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED + 2; i++){
+        add_string(&buffer, "entry\n");
+    }
+
+    // Entries 0 and 1 were overwritten, seq 0 lands on the oldest one kept
+    entry = aesd_circular_buffer_find_entry_for_seq(&buffer, 0, &fpos);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_UINT64(2, entry->seq);
+    TEST_ASSERT_EQUAL_size_t(0, fpos);
+
+    entry = aesd_circular_buffer_find_entry_for_seq(&buffer, 5, &fpos);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_UINT64(5, entry->seq);
+    TEST_ASSERT_EQUAL_size_t(3 * 6, fpos);
+
+    TEST_ASSERT_NULL(aesd_circular_buffer_find_entry_for_seq(&buffer, AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED + 2, &fpos));
+}
+
+/**
+* Verifies a time lookup finds the first entry stored at or after a timestamp, including timestamps
+* between and beyond the stored ones.
+*/
+void test_circular_buffer_find_by_time()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry *entry;
+    uint64_t previous = 0;
+    size_t fpos, count, i;
+
+    aesd_circular_buffer_init(&buffer);
+    TEST_ASSERT_NULL(aesd_circular_buffer_find_entry_for_time(&buffer, 0, &fpos));
+    for(i = 0; i < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; i++){
+        add_string(&buffer, "timed entry\n");
+    }
+
+    count = aesd_circular_buffer_entry_count(&buffer);
+    for(i = 0; i < count; i++){
+        struct aesd_buffer_entry *expected = &buffer.entry[(buffer.out_offs + i) & buffer.mask];
+
+        TEST_ASSERT_TRUE_MESSAGE(expected->timestamp >= previous, "Timestamps must never decrease");
+        previous = expected->timestamp;
+
+        // Entries sharing a timestamp resolve to the first of them
+        entry = aesd_circular_buffer_find_entry_for_time(&buffer, expected->timestamp, &fpos);
+        TEST_ASSERT_NOT_NULL(entry);
+        TEST_ASSERT_EQUAL_UINT64(expected->timestamp, entry->timestamp);
+        TEST_ASSERT_TRUE(entry->seq <= expected->seq);
+        TEST_ASSERT_EQUAL_size_t(entry->seq * 12, fpos);
+    }
+
+    entry = aesd_circular_buffer_find_entry_for_time(&buffer, 0, &fpos);
+    TEST_ASSERT_EQUAL_UINT64(0, entry->seq);
+    TEST_ASSERT_NULL(aesd_circular_buffer_find_entry_for_time(&buffer, previous + 1, &fpos));
+}